@@ -0,0 +1,104 @@
+#ifndef LIBVARLINK_BENCH_HPP
+#define LIBVARLINK_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <varlink/detail/nl_json.hpp>
+
+namespace varlink::bench {
+using clock = std::chrono::steady_clock;
+
+// Number of operator new calls so far, counted by bench_main.cpp
+uint64_t allocation_count() noexcept;
+
+class state {
+  public:
+    explicit state(size_t iterations) : iterations_(iterations) {}
+
+    [[nodiscard]] size_t iterations() const { return iterations_; }
+
+    void start()
+    {
+        allocations_started_ = allocation_count();
+        started_ = clock::now();
+    }
+    void stop()
+    {
+        elapsed_ += clock::now() - started_;
+        allocations_ += allocation_count() - allocations_started_;
+    }
+
+    void add_items(size_t n) { items_ += n; }
+
+    // Latency of a single operation, reported as percentiles. The samples are kept, the
+    // first one reserves space for iterations() of them.
+    void add_latency(clock::duration latency)
+    {
+        if (latencies_.empty()) { latencies_.reserve(iterations_); }
+        latencies_.push_back(latency);
+    }
+    void set_counter(const std::string& name, json value) { counters_[name] = std::move(value); }
+
+    [[nodiscard]] json report(const std::string& name) const
+    {
+        const auto seconds = std::chrono::duration<double>(elapsed_).count();
+        json r = {
+            {"name", name},
+            {"iterations", iterations_},
+            {"items", items_},
+            {"seconds", seconds},
+            {"items_per_second", seconds > 0 ? static_cast<double>(items_) / seconds : 0.0},
+            {"allocations", allocations_},
+            {"allocations_per_item",
+             items_ > 0 ? static_cast<double>(allocations_) / static_cast<double>(items_) : 0.0}};
+        if (not latencies_.empty()) {
+            auto sorted = latencies_;
+            std::sort(sorted.begin(), sorted.end());
+            const auto percentile = [&sorted](double p) {
+                const auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(sorted[rank]).count();
+            };
+            r["latency_p50_ns"] = percentile(0.5);
+            r["latency_p99_ns"] = percentile(0.99);
+            r["latency_p999_ns"] = percentile(0.999);
+        }
+        for (const auto& [key, value] : counters_) {
+            r[key] = value;
+        }
+        return r;
+    }
+
+  private:
+    size_t iterations_;
+    size_t items_{0};
+    clock::time_point started_{};
+    clock::duration elapsed_{};
+    uint64_t allocations_started_{0};
+    uint64_t allocations_{0};
+    std::vector<clock::duration> latencies_{};
+    std::map<std::string, json> counters_{};
+};
+
+using benchmark_function = std::function<void(state&)>;
+
+inline std::map<std::string, benchmark_function>& registry()
+{
+    static std::map<std::string, benchmark_function> benchmarks;
+    return benchmarks;
+}
+
+struct registrar {
+    registrar(const char* name, benchmark_function fn) { registry().emplace(name, std::move(fn)); }
+};
+} // namespace varlink::bench
+
+#define VARLINK_BENCHMARK(ID, NAME)                                     \
+    static void ID(::varlink::bench::state&);                           \
+    static const ::varlink::bench::registrar ID##_registrar{NAME, &ID}; \
+    static void ID(::varlink::bench::state& state)
+
+#endif // LIBVARLINK_BENCH_HPP
@@ -0,0 +1,101 @@
+#include <thread>
+#include <experimental/filesystem>
+#include <varlink/threaded_server.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+constexpr size_t client_threads = 8;
+constexpr size_t server_threads = 4;
+
+// Client threads connect, make a single call and disconnect as fast as they can, like the
+// connection storm after a service restart. Connections are reset on close, so the
+// client ports don't pile up in TIME_WAIT.
+template <typename Protocol>
+void run_connection_storm(
+    bench::state& state,
+    std::string_view uri,
+    const typename Protocol::endpoint& endpoint,
+    threading_model model)
+{
+    const varlink_service::description description{"varlink", "bench", "1", "https://varlink.org"};
+    threaded_server server{uri, description, server_threads, model};
+    const auto connections = std::max<size_t>(state.iterations() / 10, client_threads);
+    const auto per_thread = connections / client_threads;
+    const json call = {{"method", "org.varlink.service.GetInfo"}};
+
+    state.start();
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < client_threads; t++) {
+        clients.emplace_back([&]() {
+            net::io_context ctx{};
+            for (size_t i = 0; i < per_thread; i++) {
+                json_connection<Protocol> conn{ctx};
+                conn.connect(endpoint);
+                conn.send(call);
+                if (not conn.receive().contains("parameters")) {
+                    throw std::runtime_error("unexpected reply");
+                }
+                if constexpr (std::is_same_v<Protocol, net::ip::tcp>) {
+                    conn.socket().set_option(net::socket_base::linger(true, 0));
+                }
+                conn.close();
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    state.stop();
+    server.stop();
+    server.join();
+    state.add_items(per_thread * client_threads);
+}
+
+void run_tcp(bench::state& state, threading_model model)
+{
+    run_connection_storm<net::ip::tcp>(
+        state,
+        "tcp:127.0.0.1:52337",
+        {net::ip::make_address_v4("127.0.0.1"), 52337},
+        model);
+}
+
+void run_unix(bench::state& state, threading_model model)
+{
+    std::experimental::filesystem::remove("varlink-bench-accept.socket");
+    run_connection_storm<net::local::stream_protocol>(
+        state, "unix:varlink-bench-accept.socket", {"varlink-bench-accept.socket"}, model);
+}
+} // namespace
+
+VARLINK_BENCHMARK(accept_tcp_shared_pool, "accept/tcp_shared_pool")
+{
+    run_tcp(state, threading_model::shared_pool);
+}
+
+VARLINK_BENCHMARK(accept_tcp_io_context_per_thread, "accept/tcp_io_context_per_thread")
+{
+    run_tcp(state, threading_model::io_context_per_thread);
+}
+
+VARLINK_BENCHMARK(accept_tcp_acceptor_per_thread, "accept/tcp_acceptor_per_thread")
+{
+    run_tcp(state, threading_model::acceptor_per_thread);
+}
+
+VARLINK_BENCHMARK(accept_unix_shared_pool, "accept/unix_shared_pool")
+{
+    run_unix(state, threading_model::shared_pool);
+}
+
+VARLINK_BENCHMARK(accept_unix_io_context_per_thread, "accept/unix_io_context_per_thread")
+{
+    run_unix(state, threading_model::io_context_per_thread);
+}
+
+VARLINK_BENCHMARK(accept_unix_acceptor_per_thread, "accept/unix_acceptor_per_thread")
+{
+    run_unix(state, threading_model::acceptor_per_thread);
+}
@@ -0,0 +1,92 @@
+#include <future>
+#include <mutex>
+#include <thread>
+#include <experimental/filesystem>
+#include <varlink/client_pool.hpp>
+#include <varlink/threaded_server.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+constexpr size_t caller_threads = 16;
+constexpr size_t server_threads = 4;
+constexpr std::string_view socket_path = "varlink-bench-pool.socket";
+constexpr std::string_view uri = "unix:varlink-bench-pool.socket";
+
+// Every caller thread makes synchronous calls as fast as it can. call_fn(thread, i) does
+// a single call.
+template <typename CallFunction>
+void run_callers(bench::state& state, CallFunction&& call_fn)
+{
+    std::experimental::filesystem::remove(socket_path);
+    const varlink_service::description description{"varlink", "bench", "1", "https://varlink.org"};
+    threaded_server server{uri, description, server_threads};
+    const auto per_thread = std::max<size_t>(state.iterations() / caller_threads, 1);
+
+    state.start();
+    std::vector<std::thread> callers;
+    for (size_t t = 0; t < caller_threads; t++) {
+        callers.emplace_back([&, t]() {
+            for (size_t i = 0; i < per_thread; i++) {
+                if (not call_fn(t, i).contains("vendor")) {
+                    throw std::runtime_error("unexpected reply");
+                }
+            }
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    state.stop();
+    server.stop();
+    server.join();
+    state.add_items(per_thread * caller_threads);
+}
+} // namespace
+
+// What callers without a pool do: share a single client and serialize on it
+VARLINK_BENCHMARK(client_pool_shared_client, "client_pool/shared_client")
+{
+    net::io_context ctx{};
+    std::mutex mutex{};
+    std::optional<varlink_client> client{};
+    run_callers(state, [&](size_t, size_t) {
+        std::lock_guard lock(mutex);
+        if (not client) { client.emplace(ctx, uri); }
+        return client->call("org.varlink.service.GetInfo", json::object());
+    });
+}
+
+VARLINK_BENCHMARK(client_pool_sync, "client_pool/sync")
+{
+    net::io_context ctx{};
+    varlink_client_pool pool{ctx, server_threads};
+    run_callers(state, [&](size_t, size_t) {
+        return pool.call(uri, "org.varlink.service.GetInfo", json::object());
+    });
+    state.set_counter("connections", pool.connection_count(uri));
+}
+
+// The callers only start the call, the replies are handled by a single io_context thread
+VARLINK_BENCHMARK(client_pool_async, "client_pool/async")
+{
+    net::io_context ctx{};
+    auto work = net::make_work_guard(ctx);
+    std::thread io([&]() { ctx.run(); });
+    varlink_client_pool pool{ctx, server_threads};
+    run_callers(state, [&](size_t, size_t) {
+        std::promise<json> reply{};
+        pool.async_call(
+            uri, "org.varlink.service.GetInfo", json::object(), [&](auto ec, const json& r) {
+                if (ec) { reply.set_exception(std::make_exception_ptr(std::system_error(ec))); }
+                else {
+                    reply.set_value(r);
+                }
+            });
+        return reply.get_future().get();
+    });
+    state.set_counter("connections", pool.connection_count(uri));
+    work.reset();
+    io.join();
+}
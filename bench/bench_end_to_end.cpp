@@ -0,0 +1,201 @@
+#include <sstream>
+#include <thread>
+#include <experimental/filesystem>
+#include <varlink/client.hpp>
+#include <varlink/server.hpp>
+#include <varlink/threaded_server.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+constexpr std::string_view echo_interface = R"INTERFACE(
+interface org.example.echo
+method Echo(data: string) -> (data: string)
+method Stream(count: int) -> (n: int)
+method Notify(data: string) -> ()
+)INTERFACE";
+
+constexpr size_t server_threads = 4;
+constexpr int64_t stream_replies = 4;
+constexpr std::string_view socket_path = "varlink-bench-e2e.socket";
+constexpr std::string_view unix_uri = "unix:varlink-bench-e2e.socket";
+constexpr std::string_view tcp_uri = "tcp:127.0.0.1:52338";
+const varlink_service::description description{"varlink", "bench", "1", "https://varlink.org"};
+
+callback_map echo_callbacks()
+{
+    return {
+        {"Echo", [] varlink_callback { send_reply({{"data", parameters["data"]}}, false); }},
+        {"Stream",
+         [] varlink_callback {
+             const auto count = parameters["count"].get<int64_t>();
+             for (int64_t n = 1; n < count and mode == callmode::more; n++) {
+                 send_reply({{"n", n}}, true);
+             }
+             send_reply({{"n", count}}, false);
+         }},
+        {"Notify", [] varlink_callback { send_reply({}, false); }},
+    };
+}
+
+const json echo_parameters = {{"data", std::string(64, 'x')}};
+
+// A synchronous client makes one call after the other, the latency is its round trip
+void echo(bench::state& state, std::string_view uri)
+{
+    net::io_context ctx{};
+    varlink_client client{ctx, uri};
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto begin = bench::clock::now();
+        const auto reply = client.call("org.example.echo.Echo", echo_parameters);
+        state.add_latency(bench::clock::now() - begin);
+        if (not reply.contains("data")) throw std::runtime_error("unexpected reply");
+    }
+    state.stop();
+    state.add_items(state.iterations());
+}
+
+// Every call gets stream_replies replies, items are replies and the latency is the time
+// until the last one arrived
+void more(bench::state& state, std::string_view uri)
+{
+    net::io_context ctx{};
+    varlink_client client{ctx, uri};
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto begin = bench::clock::now();
+        auto next_reply =
+            client.call_more("org.example.echo.Stream", json{{"count", stream_replies}});
+        for (auto reply = next_reply(); not reply.is_null(); reply = next_reply()) {
+            ++replies;
+        }
+        state.add_latency(bench::clock::now() - begin);
+    }
+    state.stop();
+    if (replies != state.iterations() * stream_replies) {
+        throw std::runtime_error("unexpected reply count");
+    }
+    state.add_items(replies);
+}
+
+// Oneway calls don't wait for the server, the latency is the time to send one. A final
+// call with a reply makes sure the server handled all of them before the clock stops.
+void oneway(bench::state& state, std::string_view uri)
+{
+    net::io_context ctx{};
+    varlink_client client{ctx, uri};
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto begin = bench::clock::now();
+        client.call_oneway("org.example.echo.Notify", echo_parameters);
+        state.add_latency(bench::clock::now() - begin);
+    }
+    (void)client.call("org.example.echo.Echo", echo_parameters);
+    state.stop();
+    state.add_items(state.iterations());
+}
+
+using workload = void (*)(bench::state&, std::string_view);
+
+// varlink_server, serving every connection on a single io_context thread
+void run_varlink_server(bench::state& state, std::string_view uri, workload run)
+{
+    std::experimental::filesystem::remove(socket_path);
+    net::io_context ctx{};
+    varlink_server server{ctx, uri, description};
+    server.add_interface(echo_interface, echo_callbacks());
+    server.async_serve_forever();
+    std::thread io([&]() { ctx.run(); });
+    run(state, uri);
+    ctx.stop();
+    io.join();
+}
+
+void run_threaded_server(bench::state& state, std::string_view uri, workload run)
+{
+    std::experimental::filesystem::remove(socket_path);
+    threaded_server server{uri, description, server_threads};
+    server.add_interface(echo_interface, echo_callbacks());
+    run(state, uri);
+    server.stop();
+    server.join();
+    state.set_counter("server_threads", server_threads);
+}
+} // namespace
+
+VARLINK_BENCHMARK(e2e_varlink_server_unix_echo, "end_to_end/varlink_server/unix/echo")
+{
+    run_varlink_server(state, unix_uri, echo);
+}
+
+VARLINK_BENCHMARK(e2e_varlink_server_unix_more, "end_to_end/varlink_server/unix/more")
+{
+    run_varlink_server(state, unix_uri, more);
+}
+
+VARLINK_BENCHMARK(e2e_varlink_server_unix_oneway, "end_to_end/varlink_server/unix/oneway")
+{
+    run_varlink_server(state, unix_uri, oneway);
+}
+
+VARLINK_BENCHMARK(e2e_varlink_server_tcp_echo, "end_to_end/varlink_server/tcp/echo")
+{
+    run_varlink_server(state, tcp_uri, echo);
+}
+
+VARLINK_BENCHMARK(e2e_varlink_server_tcp_more, "end_to_end/varlink_server/tcp/more")
+{
+    run_varlink_server(state, tcp_uri, more);
+}
+
+VARLINK_BENCHMARK(e2e_varlink_server_tcp_oneway, "end_to_end/varlink_server/tcp/oneway")
+{
+    run_varlink_server(state, tcp_uri, oneway);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_unix_echo, "end_to_end/threaded_server/unix/echo")
+{
+    run_threaded_server(state, unix_uri, echo);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_unix_more, "end_to_end/threaded_server/unix/more")
+{
+    run_threaded_server(state, unix_uri, more);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_unix_oneway, "end_to_end/threaded_server/unix/oneway")
+{
+    run_threaded_server(state, unix_uri, oneway);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_tcp_echo, "end_to_end/threaded_server/tcp/echo")
+{
+    run_threaded_server(state, tcp_uri, echo);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_tcp_more, "end_to_end/threaded_server/tcp/more")
+{
+    run_threaded_server(state, tcp_uri, more);
+}
+
+VARLINK_BENCHMARK(e2e_threaded_server_tcp_oneway, "end_to_end/threaded_server/tcp/oneway")
+{
+    run_threaded_server(state, tcp_uri, oneway);
+}
+
+#ifdef VARLINK_ENABLE_TRACING
+// Every call is traced, the trace is exported once the calls are done
+VARLINK_BENCHMARK(
+    e2e_threaded_server_unix_echo_traced, "end_to_end/threaded_server/unix/echo_traced")
+{
+    start_tracing();
+    run_threaded_server(state, unix_uri, echo);
+    stop_tracing();
+    std::stringstream trace{};
+    write_chrome_trace(trace);
+    state.set_counter("trace_bytes", trace.str().size());
+}
+#endif
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "bench.hpp"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace varlink;
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+uint64_t bench::allocation_count() noexcept
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Usage: varlink_bench [--iterations N] [filter...]
+// Runs every benchmark whose name contains one of the filters (or all of them)
+// and prints the results as a JSON array to stdout.
+int main(int argc, char** argv)
+{
+    signal(SIGPIPE, SIG_IGN);
+#ifdef __GLIBC__
+    // Otherwise glibc returns memory at the top of the heap to the system and asks for it
+    // again, depending on the heap layout, which makes results differ between builds
+    mallopt(M_TRIM_THRESHOLD, 256 * 1024 * 1024);
+    mallopt(M_TOP_PAD, 64 * 1024 * 1024);
+    mallopt(M_MMAP_THRESHOLD, 256 * 1024 * 1024);
+#endif
+    size_t iterations = 100000;
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--iterations" and i + 1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        }
+        else {
+            filters.push_back(arg);
+        }
+    }
+
+    auto selected = [&](const std::string& name) {
+        if (filters.empty()) return true;
+        return std::any_of(filters.begin(), filters.end(), [&](const auto& f) {
+            return name.find(f) != std::string::npos;
+        });
+    };
+
+    json results = json::array();
+    for (const auto& [name, benchmark] : bench::registry()) {
+        if (not selected(name)) continue;
+        bench::state state{iterations};
+        benchmark(state);
+        results.push_back(state.report(name));
+        const auto& result = results.back();
+        std::cerr << name << ": " << result["items_per_second"].get<double>() << " items/s";
+        if (result.contains("latency_p99_ns")) {
+            std::cerr << ", p99 " << result["latency_p99_ns"].get<int64_t>() << " ns";
+        }
+        std::cerr << "\n";
+    }
+    std::cout << results.dump(2) << std::endl;
+    return 0;
+}
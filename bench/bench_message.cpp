@@ -0,0 +1,125 @@
+#include <varlink/detail/call_parser.hpp>
+#include <varlink/detail/message.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+const json call = {
+    {"method", "org.example.more.Ping"},
+    {"parameters", {{"ping", "Test"}}},
+    {"more", true}};
+}
+
+VARLINK_BENCHMARK(message_construct, "message/construct")
+{
+    size_t more_calls = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const basic_varlink_message message{call};
+        if (message.mode() == callmode::more) ++more_calls;
+    }
+    state.stop();
+    state.add_items(more_calls);
+}
+
+// What message_call reads from every message
+VARLINK_BENCHMARK(message_accessors, "message/accessors")
+{
+    const basic_varlink_message message{call};
+    size_t length = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        length += message.interface().size() + message.method().size();
+        length += message.parameters().size();
+    }
+    state.stop();
+    state.add_items(state.iterations());
+    state.set_counter("checksum", length);
+}
+
+namespace {
+// The calls of one certification run, as received by the server
+std::vector<std::string> certification_frames()
+{
+    const json mytype = R"json({
+        "object": {"method": "org.varlink.certification.Test09",
+                   "parameters": {"map": {"foo": "Foo", "bar": "Bar"}}},
+        "enum": "two",
+        "struct": {"first": 1, "second": "2"},
+        "array": ["one", "two", "three"],
+        "dictionary": {"foo": "Foo", "bar": "Bar"},
+        "stringset": {"one": {}, "two": {}, "three": {}},
+        "interface": {
+            "foo": [{}, {"foo": "foo", "bar": "bar"}, {}, {"one": "foo", "two": "bar"}],
+            "anon": {"foo": true, "bar": false}
+        }
+    })json"_json;
+    const std::string id = "0123456789abcdef";
+    const std::string iface = "org.varlink.certification.";
+    const std::vector<json> calls{
+        {{"method", iface + "Start"}},
+        {{"method", iface + "Test01"}, {"parameters", {{"client_id", id}}}},
+        {{"method", iface + "Test02"}, {"parameters", {{"client_id", id}, {"bool", true}}}},
+        {{"method", iface + "Test03"}, {"parameters", {{"client_id", id}, {"int", 1}}}},
+        {{"method", iface + "Test04"}, {"parameters", {{"client_id", id}, {"float", 1.0}}}},
+        {{"method", iface + "Test05"}, {"parameters", {{"client_id", id}, {"string", "ping"}}}},
+        {{"method", iface + "Test06"},
+         {"parameters",
+          {{"client_id", id}, {"bool", false}, {"int", 2}, {"float", 3.14}, {"string", "a"}}}},
+        {{"method", iface + "Test07"},
+         {"parameters",
+          {{"client_id", id},
+           {"struct", {{"bool", false}, {"int", 2}, {"float", 3.14}, {"string", "a"}}}}}},
+        {{"method", iface + "Test08"},
+         {"parameters", {{"client_id", id}, {"map", {{"foo", "Foo"}, {"bar", "Bar"}}}}}},
+        {{"method", iface + "Test09"},
+         {"parameters", {{"client_id", id}, {"set", {{"one", {}}, {"two", {}}, {"three", {}}}}}}},
+        {{"method", iface + "Test10"},
+         {"parameters", {{"client_id", id}, {"mytype", mytype}}},
+         {"more", true}},
+        {{"method", iface + "Test11"},
+         {"parameters", {{"client_id", id}, {"last_more_replies", {"1", "2", "3", "4"}}}},
+         {"oneway", true}},
+        {{"method", iface + "End"}, {"parameters", {{"client_id", id}}}},
+    };
+    std::vector<std::string> frames;
+    for (const auto& call : calls) {
+        frames.push_back(call.dump());
+    }
+    return frames;
+}
+
+template <typename Parse>
+void parse_certification(bench::state& state, Parse&& parse)
+{
+    const auto frames = certification_frames();
+    size_t parameters = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        for (const auto& frame : frames) {
+            const basic_varlink_message message = parse(frame);
+            parameters += message.parameters().size();
+        }
+    }
+    state.stop();
+    state.add_items(state.iterations() * frames.size());
+    state.set_counter("checksum", parameters);
+}
+} // namespace
+
+// Received frame to message, like the server did before the call parser
+VARLINK_BENCHMARK(message_parse_certification_dom, "message/parse_certification_dom")
+{
+    parse_certification(state, [](const std::string& frame) {
+        return basic_varlink_message(json::parse(frame));
+    });
+}
+
+// Received frame to message with the SAX call parser the server uses
+VARLINK_BENCHMARK(message_parse_certification_sax, "message/parse_certification_sax")
+{
+    parse_certification(state, [](const std::string& frame) {
+        return detail::parse_call(frame.data(), frame.data() + frame.size()).value();
+    });
+}
@@ -0,0 +1,157 @@
+#include <thread>
+#include <varlink/async_client.hpp>
+#include <varlink/server_session.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+using unix_connection = json_connection<net::local::stream_protocol>;
+using unix_session = server_session<net::local::stream_protocol>;
+using unix_client = async_client<net::local::stream_protocol>;
+
+namespace {
+constexpr std::string_view bench_interface = R"INTERFACE(
+interface org.example.bench
+method Ping(ping: int) -> (pong: int)
+)INTERFACE";
+
+// Time a call spends in the (simulated) backend before it replies
+constexpr auto backend_latency = std::chrono::microseconds(20);
+
+void add_bench_interface(varlink_service& service, net::thread_pool& workers)
+{
+    service.add_interface(
+        bench_interface,
+        callback_map{
+            {"Ping", [&workers] varlink_callback {
+                 auto timer = std::make_shared<net::steady_timer>(workers, backend_latency);
+                 timer->async_wait([timer, ping = parameters["ping"], send_reply](auto) {
+                     send_reply({{"pong", ping}}, false);
+                 });
+             }}});
+}
+
+// A client pipelines all calls at once while the server hands each of them off to a
+// worker pool, as a callback waiting on a backend would. Replies are checked to arrive
+// in request order.
+void run_pipeline(bench::state& state, size_t depth)
+{
+    net::thread_pool workers{4};
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    add_bench_interface(service, workers);
+
+    net::io_context ctx{};
+    net::local::stream_protocol::socket client_socket{ctx};
+    net::local::stream_protocol::socket server_socket{ctx};
+    net::local::connect_pair(client_socket, server_socket);
+    unix_connection client{std::move(client_socket)};
+    auto session = std::make_shared<unix_session>(std::move(server_socket), service);
+    session->set_pipeline_depth(depth);
+    session->start();
+    session.reset();
+
+    std::string requests;
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const json call = {{"method", "org.example.bench.Ping"}, {"parameters", {{"ping", i}}}};
+        requests += call.dump();
+        requests += '\0';
+    }
+
+    // Replies come from the workers, so ctx may run out of work while a call is in flight
+    auto work = net::make_work_guard(ctx);
+    state.start();
+    std::thread server([&]() { ctx.run(); });
+    std::thread producer([&]() { net::write(client.socket(), net::buffer(requests)); });
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto reply = client.receive();
+        if (reply["parameters"]["pong"].get<size_t>() != i) {
+            throw std::runtime_error("reply out of order");
+        }
+    }
+    state.stop();
+    producer.join();
+    client.close();
+    work.reset();
+    server.join();
+    workers.join();
+    state.add_items(state.iterations());
+    state.set_counter("pipeline_depth", depth);
+}
+
+// Issues all calls through async_client at once against a session that accepts
+// max_in_flight calls. Without pipelining, the client still waits for each reply before
+// sending the next call.
+void run_client(bench::state& state, bool pipelined)
+{
+    constexpr size_t max_in_flight = 64;
+    net::thread_pool workers{4};
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    add_bench_interface(service, workers);
+
+    net::io_context ctx{};
+    net::local::stream_protocol::socket client_socket{ctx};
+    net::local::stream_protocol::socket server_socket{ctx};
+    net::local::connect_pair(client_socket, server_socket);
+    unix_client client{std::move(client_socket)};
+    client.set_pipelined(pipelined);
+    auto session = std::make_shared<unix_session>(std::move(server_socket), service);
+    session->set_pipeline_depth(max_in_flight);
+    session->start();
+    session.reset();
+
+    // Replies come from the workers, so ctx may run out of work while a call is in flight
+    auto work = net::make_work_guard(ctx);
+    size_t next_call{0};
+    size_t replies{0};
+    std::function<void()> call_next = [&]() {
+        const auto ping = next_call++;
+        client.async_call(
+            "org.example.bench.Ping", {{"ping", ping}}, [&, ping](auto ec, const json& reply) {
+                if (ec or reply["pong"].get<size_t>() != ping) {
+                    throw std::runtime_error("unexpected reply");
+                }
+                if (++replies == state.iterations()) {
+                    client.close();
+                    work.reset();
+                }
+                else if (next_call < state.iterations()) {
+                    call_next();
+                }
+            });
+    };
+
+    state.start();
+    for (size_t i = 0; i < std::min(max_in_flight, state.iterations()); i++) {
+        call_next();
+    }
+    ctx.run();
+    state.stop();
+    workers.join();
+    state.add_items(state.iterations());
+    state.set_counter("pipelined", pipelined);
+}
+} // namespace
+
+VARLINK_BENCHMARK(pipeline_depth_1, "pipeline/depth_1")
+{
+    run_pipeline(state, 1);
+}
+
+VARLINK_BENCHMARK(pipeline_depth_8, "pipeline/depth_8")
+{
+    run_pipeline(state, 8);
+}
+
+VARLINK_BENCHMARK(pipeline_depth_64, "pipeline/depth_64")
+{
+    run_pipeline(state, 64);
+}
+
+VARLINK_BENCHMARK(client_sequential, "pipeline/client_sequential")
+{
+    run_client(state, false);
+}
+
+VARLINK_BENCHMARK(client_pipelined, "pipeline/client_pipelined")
+{
+    run_client(state, true);
+}
@@ -0,0 +1,269 @@
+#include <varlink/service.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+// Interface definitions must outlive the service, their names are referenced
+std::vector<std::string> make_interfaces(size_t count)
+{
+    std::vector<std::string> definitions;
+    for (size_t i = 0; i < count; i++) {
+        definitions.push_back(
+            "interface org.example.bench" + std::to_string(i) + "\n"
+            "method Ping(ping: string) -> (pong: string)\n"
+            "method Echo(value: int) -> (value: int)\n"
+            "method Unused() -> ()\n");
+    }
+    return definitions;
+}
+
+// Takes the replies the service keeps serialized, like a server session
+struct frame_counter {
+    static constexpr bool accepts_serialized = true;
+    size_t& frames;
+
+    void operator()(const json&) const { throw std::runtime_error("unexpected reply"); }
+    void operator()(serialized_reply&& reply) const
+    {
+        if (reply.frame->empty()) { throw std::runtime_error("unexpected reply"); }
+        ++frames;
+    }
+};
+} // namespace
+
+// Dispatches to the last of 48 registered interfaces
+VARLINK_BENCHMARK(service_dispatch, "service/dispatch_48_interfaces")
+{
+    const auto definitions = make_interfaces(48);
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    for (const auto& definition : definitions) {
+        service.add_interface(
+            definition,
+            callback_map{{"Ping", [] varlink_callback {
+                              send_reply({{"pong", parameters["ping"]}}, false);
+                          }}});
+    }
+    const basic_varlink_message message{
+        json{{"method", "org.example.bench47.Ping"}, {"parameters", {{"ping", "Test"}}}}};
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(message, [&](const json& reply) {
+            if (not reply.contains("parameters")) throw std::runtime_error("unexpected reply");
+            ++replies;
+        });
+    }
+    state.stop();
+    state.add_items(replies);
+}
+
+// Like a server session: every received request is turned into a message and dispatched
+VARLINK_BENCHMARK(service_construct_and_dispatch, "service/construct_and_dispatch")
+{
+    const auto definitions = make_interfaces(48);
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    for (const auto& definition : definitions) {
+        service.add_interface(
+            definition,
+            callback_map{{"Ping", [] varlink_callback {
+                              send_reply({{"pong", parameters["ping"]}}, false);
+                          }}});
+    }
+    const json request = {
+        {"method", "org.example.bench47.Ping"},
+        {"parameters", {{"ping", "Test"}}}};
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const basic_varlink_message message{request};
+        service.message_call(message, [&](const json& reply) {
+            if (not reply.contains("parameters")) throw std::runtime_error("unexpected reply");
+            ++replies;
+        });
+    }
+    state.stop();
+    state.add_items(replies);
+}
+
+namespace {
+constexpr std::string_view nested_definition = R"INTERFACE(
+interface org.example.nested
+type Color (red, green, blue)
+type Point (x: float, y: float, color: ?Color)
+type Shape (name: string, points: []Point, tags: [string]string, closed: bool)
+method Draw(shapes: []Shape, layer: int) -> (shapes: []Shape, layer: int)
+)INTERFACE";
+
+// Passes a new message for each call, like a server session, if received is set
+void dispatch_nested_types(bench::state& state, bool received)
+{
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    service.add_interface(
+        nested_definition,
+        callback_map{{"Draw", [] varlink_callback {
+                          send_reply(parameters.get<json::object_t>(), false);
+                      }}});
+    json shapes = json::array();
+    for (int i = 0; i < 4; i++) {
+        json points = json::array();
+        for (int p = 0; p < 8; p++) {
+            points.push_back({{"x", p * 1.5}, {"y", -p * 0.5}, {"color", "green"}});
+        }
+        shapes.push_back(
+            {{"name", "shape" + std::to_string(i)},
+             {"points", points},
+             {"tags", {{"owner", "bench"}, {"kind", "polygon"}}},
+             {"closed", true}});
+    }
+    const json request{
+        {"method", "org.example.nested.Draw"},
+        {"parameters", {{"shapes", shapes}, {"layer", 1}}}};
+    const basic_varlink_message message{request};
+
+    size_t replies = 0;
+    const auto count_reply = [&](const json& reply) {
+        if (not reply.contains("parameters")) throw std::runtime_error("unexpected reply");
+        ++replies;
+    };
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        if (received) { service.message_call(basic_varlink_message(request), count_reply); }
+        else {
+            service.message_call(message, count_reply);
+        }
+    }
+    state.stop();
+    state.add_items(replies);
+}
+} // namespace
+
+// Request and reply validation dominate for methods with larger, nested types
+VARLINK_BENCHMARK(service_dispatch_nested_types, "service/dispatch_nested_types")
+{
+    dispatch_nested_types(state, false);
+}
+
+VARLINK_BENCHMARK(service_dispatch_nested_types_received, "service/dispatch_nested_types_received")
+{
+    dispatch_nested_types(state, true);
+}
+
+// A callback replying with a large payload it built, which is moved through to the reply
+VARLINK_BENCHMARK(service_large_reply, "service/large_reply")
+{
+    static constexpr std::string_view definition = R"INTERFACE(
+interface org.example.large
+type Entry (name: string, value: int)
+method List() -> (entries: []Entry)
+)INTERFACE";
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    service.add_interface(
+        definition,
+        callback_map{{"List", [] varlink_callback {
+                          json::array_t entries{};
+                          entries.reserve(1024);
+                          for (int i = 0; i < 1024; i++) {
+                              entries.push_back(
+                                  {{"name", "entry" + std::to_string(i)}, {"value", i}});
+                          }
+                          json::object_t reply{};
+                          reply.emplace("entries", std::move(entries));
+                          send_reply(std::move(reply), false);
+                      }}});
+    const basic_varlink_message message{"org.example.large.List", json::object()};
+
+    size_t entries = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(message, [&](const json& reply) {
+            entries += reply["parameters"]["entries"].size();
+        });
+    }
+    state.stop();
+    state.add_items(state.iterations());
+    state.set_counter("entries", entries);
+}
+
+// Service startup, which adds the built-in org.varlink.service interface
+VARLINK_BENCHMARK(service_construct, "service/construct")
+{
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    }
+    state.stop();
+    state.add_items(state.iterations());
+}
+
+// Monitoring agents poll the org.varlink.service methods of a service with a few interfaces
+VARLINK_BENCHMARK(service_get_info, "service/get_info")
+{
+    const auto definitions = make_interfaces(8);
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    for (const auto& definition : definitions) {
+        service.add_interface(definition);
+    }
+    const basic_varlink_message message{
+        json{{"method", "org.varlink.service.GetInfo"}, {"parameters", json::object()}}};
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(message, frame_counter{replies});
+    }
+    state.stop();
+    state.add_items(replies);
+}
+
+VARLINK_BENCHMARK(service_get_interface_description, "service/get_interface_description")
+{
+    const auto definitions = make_interfaces(8);
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    for (const auto& definition : definitions) {
+        service.add_interface(definition);
+    }
+    const basic_varlink_message message{json{
+        {"method", "org.varlink.service.GetInterfaceDescription"},
+        {"parameters", {{"interface", "org.varlink.service"}}}}};
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(message, frame_counter{replies});
+    }
+    state.stop();
+    state.add_items(replies);
+}
+
+#ifdef VARLINK_ENABLE_METRICS
+// What the metrics add to every call: two clock reads and three sharded counter updates
+VARLINK_BENCHMARK(service_metrics_record, "service/metrics_record")
+{
+    detail::method_metrics metrics{};
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto started = detail::metrics_clock::now();
+        metrics.record_call();
+        metrics.record_reply(started, false);
+    }
+    state.stop();
+    state.add_items(state.iterations());
+    state.set_counter("calls", metrics.snapshot().calls);
+}
+
+VARLINK_BENCHMARK(service_metrics_snapshot, "service/metrics_snapshot")
+{
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    size_t methods = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        methods += service.metrics().methods.size();
+    }
+    state.stop();
+    state.add_items(state.iterations());
+    state.set_counter("methods", methods / state.iterations());
+}
+#endif
@@ -0,0 +1,48 @@
+#include <array>
+#include <varlink/detail/manual_strand.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+using strand_type = detail::manual_strand<net::io_context::executor_type>;
+
+// Calls queue up on the strand while the previous one is in flight, like async_client
+// does when the application starts calls faster than replies arrive. Every function
+// captures about as much state as a call with its completion handler and hands the
+// strand on when done.
+void run_strand(bench::state& state, size_t batch)
+{
+    net::io_context ctx{};
+    strand_type strand{ctx.get_executor()};
+    size_t executed = 0;
+    const auto rounds = std::max<size_t>(state.iterations() / batch, 1);
+
+    state.start();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < batch; i++) {
+            std::array<void*, 4> captured{};
+            strand.push([&strand, &executed, captured]() {
+                (void)captured;
+                ++executed;
+                strand.next();
+            });
+        }
+        ctx.run();
+        ctx.restart();
+    }
+    state.stop();
+    if (executed != rounds * batch) { throw std::runtime_error("lost strand function"); }
+    state.add_items(executed);
+}
+} // namespace
+
+VARLINK_BENCHMARK(strand_push_next_1, "strand/push_next_1")
+{
+    run_strand(state, 1);
+}
+
+VARLINK_BENCHMARK(strand_push_next_64, "strand/push_next_64")
+{
+    run_strand(state, 64);
+}
@@ -0,0 +1,179 @@
+#include <optional>
+#include <thread>
+#include <varlink/json_connection.hpp>
+#include "bench.hpp"
+#include "fake_socket.hpp"
+
+using namespace varlink;
+using unix_connection = json_connection<net::local::stream_protocol>;
+using fake_connection = json_connection<fake_proto>;
+
+namespace {
+constexpr std::string_view ping_call =
+    R"({"method":"org.example.more.Ping","parameters":{"ping":"Test"}})";
+
+// A pipelined stream of small method calls, as a client sending without waiting would produce.
+std::string make_pipelined_stream(size_t count)
+{
+    std::string stream;
+    stream.reserve(count * (ping_call.size() + 1));
+    for (size_t i = 0; i < count; i++) {
+        stream += ping_call;
+        stream += '\0';
+    }
+    return stream;
+}
+} // namespace
+
+VARLINK_BENCHMARK(transport_receive_pipelined, "transport/receive_pipelined")
+{
+    net::io_context ctx{};
+    net::local::stream_protocol::socket writer{ctx};
+    net::local::stream_protocol::socket reader{ctx};
+    net::local::connect_pair(writer, reader);
+    unix_connection conn{std::move(reader)};
+    const auto stream = make_pipelined_stream(state.iterations());
+
+    std::thread producer([&]() { net::write(writer, net::buffer(stream)); });
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        const auto message = conn.receive();
+        if (not message.is_object()) throw std::runtime_error("unexpected message");
+    }
+    state.stop();
+    producer.join();
+    state.add_items(state.iterations());
+}
+
+VARLINK_BENCHMARK(transport_async_receive_pipelined, "transport/async_receive_pipelined")
+{
+    net::io_context ctx{};
+    net::local::stream_protocol::socket writer{ctx};
+    net::local::stream_protocol::socket reader{ctx};
+    net::local::connect_pair(writer, reader);
+    unix_connection conn{std::move(reader)};
+    const auto stream = make_pipelined_stream(state.iterations());
+
+    size_t received = 0;
+    std::function<void(std::error_code, json)> on_message = [&](auto ec, const json&) {
+        if (ec) throw std::system_error(ec);
+        if (++received < state.iterations()) conn.async_receive(on_message);
+    };
+    std::thread producer([&]() { net::write(writer, net::buffer(stream)); });
+    state.start();
+    conn.async_receive(on_message);
+    ctx.run();
+    state.stop();
+    producer.join();
+    state.add_items(received);
+}
+
+VARLINK_BENCHMARK(transport_async_send_burst, "transport/async_send_burst")
+{
+    net::io_context ctx{};
+    net::local::stream_protocol::socket writer{ctx};
+    net::local::stream_protocol::socket reader{ctx};
+    net::local::connect_pair(writer, reader);
+    unix_connection conn{std::move(writer)};
+    const auto reply = json{{"parameters", {{"pong", "Test"}}}, {"continues", true}};
+
+    std::thread consumer([&]() {
+        std::vector<char> sink(1 << 16);
+        try {
+            while (true) {
+                reader.read_some(net::buffer(sink));
+            }
+        }
+        catch (const std::exception&) {
+            // writer closed
+        }
+    });
+    // Keep a window of outstanding replies, like a server answering pipelined calls
+    constexpr size_t window = 64;
+    size_t sent = 0;
+    size_t completed = 0;
+    std::function<void(std::error_code)> on_sent = [&](std::error_code ec) {
+        if (ec) throw std::system_error(ec);
+        ++completed;
+        if (sent < state.iterations()) {
+            ++sent;
+            conn.async_send(reply, on_sent);
+        }
+    };
+    state.start();
+    for (; sent < std::min(window, state.iterations()); sent++) {
+        conn.async_send(reply, on_sent);
+    }
+    ctx.run();
+    state.stop();
+    conn.close();
+    consumer.join();
+    state.add_items(completed);
+    const auto stats = conn.write_stats();
+    state.set_counter("writes", stats.writes);
+    state.set_counter("frames_per_write", static_cast<double>(stats.frames) / stats.writes);
+}
+
+// The fake socket benches leave out the syscalls and measure framing, parsing and
+// serialization alone. The fake socket copies received data from the front of a vector,
+// so it is refilled in batches.
+VARLINK_BENCHMARK(transport_fake_socket_receive, "transport/fake_socket_receive")
+{
+    constexpr size_t batch = 64;
+    net::io_context ctx{};
+    fake_connection conn{FakeSocket{ctx}};
+    const auto stream = make_pipelined_stream(batch);
+
+    size_t received = 0;
+    state.start();
+    while (received < state.iterations()) {
+        conn.socket().setup_fake(net::buffer(stream));
+        for (size_t i = 0; i < batch; i++, received++) {
+            const auto message = conn.receive();
+            if (not message.is_object()) throw std::runtime_error("unexpected message");
+        }
+    }
+    state.stop();
+    state.add_items(received);
+}
+
+VARLINK_BENCHMARK(transport_fake_socket_receive_call, "transport/fake_socket_receive_call")
+{
+    constexpr size_t batch = 64;
+    net::io_context ctx{};
+    fake_connection conn{FakeSocket{ctx}};
+    const auto stream = make_pipelined_stream(batch);
+
+    size_t received = 0;
+    std::function<void(std::error_code, basic_varlink_message)> on_call =
+        [&](std::error_code ec, const basic_varlink_message& message) {
+            if (ec or message.method() != "Ping") throw std::runtime_error("unexpected call");
+            if (++received % batch == 0) {
+                if (received >= state.iterations()) return;
+                conn.socket().setup_fake(net::buffer(stream));
+            }
+            conn.async_receive_call(on_call);
+        };
+    state.start();
+    conn.socket().setup_fake(net::buffer(stream));
+    conn.async_receive_call(on_call);
+    ctx.run();
+    state.stop();
+    state.add_items(received);
+}
+
+VARLINK_BENCHMARK(transport_fake_socket_send, "transport/fake_socket_send")
+{
+    net::io_context ctx{};
+    std::optional<fake_connection> conn{};
+    const auto reply = json{{"parameters", {{"pong", "Test"}}}, {"continues", true}};
+
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        // The fake socket keeps everything sent, start over now and then
+        if (i % 1024 == 0) { conn.emplace(FakeSocket{ctx}); }
+        conn->send(reply);
+    }
+    state.stop();
+    state.add_items(state.iterations());
+}
@@ -0,0 +1,81 @@
+#include <varlink/service.hpp>
+#include "bench.hpp"
+#include "org.example.nested.varlink.hpp"
+
+using namespace varlink;
+
+namespace {
+namespace nested = org::example::nested;
+
+class draw_service : public nested::server {
+    void Draw(
+        nested::Draw::parameters parameters,
+        callmode,
+        const typed_reply<nested::Draw::reply>& send_reply) override
+    {
+        send_reply({std::move(parameters.shapes), parameters.layer});
+    }
+};
+
+json draw_request()
+{
+    json shapes = json::array();
+    for (int i = 0; i < 4; i++) {
+        json points = json::array();
+        for (int p = 0; p < 8; p++) {
+            points.push_back({{"x", p * 1.5}, {"y", -p * 0.5}, {"color", "green"}});
+        }
+        shapes.push_back(
+            {{"name", "shape" + std::to_string(i)},
+             {"points", points},
+             {"tags", {{"owner", "bench"}, {"kind", "polygon"}}},
+             {"closed", true}});
+    }
+    return {
+        {"method", "org.example.nested.Draw"},
+        {"parameters", {{"shapes", shapes}, {"layer", 1}}}};
+}
+} // namespace
+
+// service/dispatch_nested_types with the generated types instead of the generic validation
+VARLINK_BENCHMARK(service_dispatch_nested_types_typed, "service/dispatch_nested_types_typed")
+{
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    draw_service impl{};
+    impl.add_to(service);
+    const basic_varlink_message message{draw_request()};
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(message, [&](const json& reply) {
+            if (not reply.contains("parameters")) throw std::runtime_error("unexpected reply");
+            ++replies;
+        });
+    }
+    state.stop();
+    state.add_items(replies);
+}
+
+// Like a server session, which passes every received message on to be consumed. The generated
+// callbacks move the parameters into their structs, compare with
+// service/dispatch_nested_types_received.
+VARLINK_BENCHMARK(
+    service_dispatch_nested_types_typed_received, "service/dispatch_nested_types_typed_received")
+{
+    varlink_service service{{"varlink", "bench", "1", "https://varlink.org"}};
+    draw_service impl{};
+    impl.add_to(service);
+    const json request = draw_request();
+
+    size_t replies = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        service.message_call(basic_varlink_message(request), [&](const json& reply) {
+            if (not reply.contains("parameters")) throw std::runtime_error("unexpected reply");
+            ++replies;
+        });
+    }
+    state.stop();
+    state.add_items(replies);
+}
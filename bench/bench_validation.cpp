@@ -0,0 +1,87 @@
+#include <varlink/detail/validator.hpp>
+#include <varlink/interface.hpp>
+#include "bench.hpp"
+
+using namespace varlink;
+
+namespace {
+constexpr std::string_view nested_interface = R"INTERFACE(
+interface org.example.nested
+type Color (red, green, blue)
+type Point (x: float, y: float, color: ?Color)
+type Shape (name: string, points: []Point, tags: [string]string, closed: bool)
+method Draw(shapes: []Shape, layer: int) -> (shapes: []Shape, layer: int)
+)INTERFACE";
+
+// Draw parameters with 4 shapes of 8 points each
+json draw_parameters()
+{
+    json shapes = json::array();
+    for (int i = 0; i < 4; i++) {
+        json points = json::array();
+        for (int p = 0; p < 8; p++) {
+            points.push_back({{"x", p * 1.5}, {"y", -p * 0.5}, {"color", "green"}});
+        }
+        shapes.push_back(
+            {{"name", "shape" + std::to_string(i)},
+             {"points", points},
+             {"tags", {{"owner", "bench"}, {"kind", "polygon"}}},
+             {"closed", true}});
+    }
+    return {{"shapes", shapes}, {"layer", 1}};
+}
+} // namespace
+
+// What varlink_interface::validate costs, it resolves the type spec on every call
+VARLINK_BENCHMARK(validation_interface_validate, "validation/interface_validate")
+{
+    const varlink_interface interface{nested_interface};
+    const auto& spec = interface.method("Draw").method_parameter_type();
+    const auto parameters = draw_parameters();
+
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        interface.validate(parameters, spec);
+    }
+    state.stop();
+    state.add_items(state.iterations());
+}
+
+// The compiled validator message_call uses for the same data
+VARLINK_BENCHMARK(validation_type_validator, "validation/type_validator")
+{
+    const varlink_interface interface{nested_interface};
+    const detail::type_validator validator{
+        interface, interface.method("Draw").method_parameter_type()};
+    const auto parameters = draw_parameters();
+
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        validator.validate(parameters);
+    }
+    state.stop();
+    state.add_items(state.iterations());
+}
+
+// Invalid data ends in an exception, the last point has no y
+VARLINK_BENCHMARK(validation_type_validator_invalid, "validation/type_validator_invalid")
+{
+    const varlink_interface interface{nested_interface};
+    const detail::type_validator validator{
+        interface, interface.method("Draw").method_parameter_type()};
+    auto parameters = draw_parameters();
+    parameters["shapes"][3]["points"][7].erase("y");
+
+    size_t rejected = 0;
+    state.start();
+    for (size_t i = 0; i < state.iterations(); i++) {
+        try {
+            validator.validate(parameters);
+        }
+        catch (const invalid_parameter&) {
+            ++rejected;
+        }
+    }
+    state.stop();
+    state.add_items(rejected);
+}
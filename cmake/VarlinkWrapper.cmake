@@ -1,11 +1,40 @@
 set(varlink-wrapper-path ${CMAKE_CURRENT_LIST_DIR})
+# varlink_wrapper(<interface> [TYPED])
+# Generates <interface>.hpp with the interface description as string constant and a
+# function returning the parsed varlink_interface. If varlink-codegen is available, the
+# interface is parsed at build time and invalid interfaces fail the build. With TYPED, which
+# requires varlink-codegen, the header also gets C++ types, a server base class and a client
+# proxy for the interface.
+# varlink-codegen is VARLINK_CODEGEN_EXECUTABLE if set, e.g. one built for the host when
+# cross-compiling. Otherwise, it is the varlink-codegen target (VARLINK_BUILD_CODEGEN), but
+# only if it can run on the build host, so not when cross-compiling.
 function(varlink_wrapper VARLINK_INTERFACE)
-    add_custom_command(OUTPUT "${VARLINK_INTERFACE}.hpp"
-            COMMAND "cmake" ARGS "-P"
-            "${varlink-wrapper-path}/varlink-wrapper.cmake"
-            "${CMAKE_CURRENT_SOURCE_DIR}/${VARLINK_INTERFACE}"
-            "${CMAKE_CURRENT_BINARY_DIR}/${VARLINK_INTERFACE}.hpp"
-            DEPENDS "${VARLINK_INTERFACE}"
-            )
+    cmake_parse_arguments(PARSE_ARGV 1 VARLINK_WRAPPER "TYPED" "" "")
+    if (VARLINK_CODEGEN_EXECUTABLE)
+        set(codegen "${VARLINK_CODEGEN_EXECUTABLE}")
+    elseif (TARGET varlink-codegen AND NOT CMAKE_CROSSCOMPILING)
+        set(codegen varlink-codegen)
+    endif ()
+    if (codegen)
+        if (VARLINK_WRAPPER_TYPED)
+            set(typed_arg "--typed")
+        endif ()
+        add_custom_command(OUTPUT "${VARLINK_INTERFACE}.hpp"
+                COMMAND ${codegen} ${typed_arg}
+                "${CMAKE_CURRENT_SOURCE_DIR}/${VARLINK_INTERFACE}"
+                "${CMAKE_CURRENT_BINARY_DIR}/${VARLINK_INTERFACE}.hpp"
+                DEPENDS "${VARLINK_INTERFACE}" ${codegen}
+                )
+    elseif (VARLINK_WRAPPER_TYPED)
+        message(FATAL_ERROR "varlink_wrapper(${VARLINK_INTERFACE} TYPED) requires varlink-codegen, "
+                "set VARLINK_CODEGEN_EXECUTABLE when cross-compiling")
+    else ()
+        add_custom_command(OUTPUT "${VARLINK_INTERFACE}.hpp"
+                COMMAND "cmake" ARGS "-P"
+                "${varlink-wrapper-path}/varlink-wrapper.cmake"
+                "${CMAKE_CURRENT_SOURCE_DIR}/${VARLINK_INTERFACE}"
+                "${CMAKE_CURRENT_BINARY_DIR}/${VARLINK_INTERFACE}.hpp"
+                DEPENDS "${VARLINK_INTERFACE}"
+                )
+    endif ()
 endfunction()
-
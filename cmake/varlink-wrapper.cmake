@@ -9,8 +9,11 @@ string(REPLACE "." "_" cstring_name ${varlink_basename})
 string(TOUPPER ${cstring_name}_H guard_name)
 
 file(READ ${CMAKE_ARGV3} varlink_if)
-set(varlink_cxxstring "#ifndef ${guard_name}\n#define ${guard_name}\n#include <string_view>\nnamespace varlink {\n")
+set(varlink_cxxstring "#ifndef ${guard_name}\n#define ${guard_name}\n#include <string_view>\n#include <varlink/interface.hpp>\nnamespace varlink {\n")
 string(APPEND varlink_cxxstring
         "inline constexpr const std::string_view ${cstring_name} = R\"INTERFACE(\n${varlink_if})INTERFACE\"\;\n")
+# Without varlink-codegen, the interface is parsed at runtime
+string(APPEND varlink_cxxstring
+        "inline varlink_interface ${cstring_name}_interface() { return varlink_interface(${cstring_name})\; }\n")
 string(APPEND varlink_cxxstring "} // namespace varlink\n#endif // ${guard_name}\n")
 file(WRITE ${CMAKE_ARGV4} ${varlink_cxxstring})
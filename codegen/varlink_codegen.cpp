@@ -0,0 +1,571 @@
+// Generates the header of varlink_wrapper(<interface>): the interface description as string
+// constant and its member table, parsed here at build time, so invalid interfaces fail the
+// build and services don't parse them on startup. With --typed (varlink_wrapper(<interface>
+// TYPED)) also C++ types, a server base class and a client proxy for the interface. See
+// include/varlink/typed.hpp for their support code.
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <varlink/interface.hpp>
+
+namespace {
+using varlink::detail::member;
+using varlink::detail::MemberKind;
+using varlink::detail::type_spec;
+using varlink::detail::vl_enum;
+using varlink::detail::vl_struct;
+
+const std::set<std::string_view> cxx_keywords{
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+    "case", "catch", "char", "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return",
+    "co_yield", "compl", "concept", "const", "const_cast", "consteval", "constexpr", "constinit",
+    "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+    "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
+    "operator", "or", "or_eq", "private", "protected", "public", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef",
+    "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+    "while", "xor", "xor_eq"};
+
+std::string identifier(std::string_view name)
+{
+    auto id = std::string(name);
+    std::replace(id.begin(), id.end(), '-', '_');
+    if (cxx_keywords.count(id) > 0) { id += '_'; }
+    return id;
+}
+
+const std::set<std::string_view> primitive_types{"bool", "int", "float", "string", "object"};
+
+// Anonymous structs and enums are emitted as nested types named after their field
+bool is_anonymous(const type_spec& spec)
+{
+    return not spec.is_string();
+}
+
+class generator {
+  public:
+    generator(const varlink::varlink_interface& interface, std::string constant)
+        : interface_(interface), constant_(std::move(constant))
+    {
+        std::string_view name = interface.name();
+        for (auto dot = name.find('.'); not name.empty(); dot = name.find('.')) {
+            if (not namespace_.empty()) { namespace_ += "::"; }
+            namespace_ += identifier(name.substr(0, dot));
+            name = (dot == std::string_view::npos) ? std::string_view{} : name.substr(dot + 1);
+        }
+    }
+
+    std::string generate()
+    {
+        line(0, "namespace " + namespace_ + " {");
+        interface_.for_each_member([&](const member& m) {
+            if (m.kind == MemberKind::Type and m.data.is_struct()) {
+                line(0, "struct " + identifier(m.name) + ";");
+            }
+        });
+        interface_.for_each_member([&](const member& m) {
+            if (m.kind == MemberKind::Type and m.data.is_enum()) {
+                out_ << "\n";
+                write_enum(0, identifier(m.name), m.data.get<vl_enum>(), "inline ");
+            }
+        });
+        interface_.for_each_member([&](const member& m) {
+            if (m.kind == MemberKind::Type and not m.data.is_enum()) { write_type(m.name); }
+        });
+        interface_.for_each_member([&](const member& m) {
+            if (m.kind == MemberKind::Method) {
+                const auto name = identifier(m.name);
+                out_ << "\n";
+                line(0, "struct " + name + " {");
+                write_name(1, m.name);
+                write_struct(1, "parameters", m.method_parameter_type());
+                write_struct(1, "reply", m.method_return_type());
+                line(0, "};");
+            }
+            else if (m.kind == MemberKind::Error) {
+                out_ << "\n";
+                line(0, "struct " + identifier(m.name) + " {");
+                write_name(1, m.name);
+                write_struct(1, "parameters", m.data);
+                line(0, "};");
+            }
+        });
+        write_server();
+        write_client();
+        line(0, "} // namespace " + namespace_);
+        return out_.str();
+    }
+
+  private:
+    const varlink::varlink_interface& interface_;
+    std::string constant_;
+    std::string namespace_{};
+    std::set<std::string_view> written_types_{};
+    std::set<std::string_view> complete_types_{};
+    std::ostringstream out_{};
+
+    void line(int indent, const std::string& text)
+    {
+        if (not text.empty()) { out_ << std::string(static_cast<size_t>(indent) * 4, ' '); }
+        out_ << text << "\n";
+    }
+
+    [[nodiscard]] std::string qualified(std::string_view name) const
+    {
+        return "::" + namespace_ + "::" + identifier(name);
+    }
+
+    void write_name(int indent, std::string_view name)
+    {
+        line(
+            indent,
+            "static constexpr std::string_view name = \"" + std::string(interface_.name()) + "."
+                + std::string(name) + "\";");
+    }
+
+    [[nodiscard]] std::string cxx_type(const type_spec& spec, const std::string& field) const
+    {
+        std::string type;
+        if (is_anonymous(spec)) { type = field + "_type"; }
+        else if (const auto& name = spec.get<varlink::detail::string_type>(); name == "bool") {
+            type = "bool";
+        }
+        else if (name == "int") {
+            type = "int64_t";
+        }
+        else if (name == "float") {
+            type = "double";
+        }
+        else if (name == "string") {
+            type = "std::string";
+        }
+        else if (name == "object") {
+            type = "::varlink::json";
+        }
+        else {
+            type = qualified(name);
+        }
+        if (spec.dict_type) { type = "std::map<std::string, " + type + ">"; }
+        if (spec.array_type) { type = "std::vector<" + type + ">"; }
+        if (spec.maybe_type) {
+            type = (is_incomplete(spec) ? "std::unique_ptr<" : "std::optional<") + type + ">";
+        }
+        return type;
+    }
+
+    // A named struct that is still being written, like the struct a recursive field is in.
+    // std::optional can't hold it, so its maybe fields hold it by std::unique_ptr.
+    [[nodiscard]] bool is_incomplete(const type_spec& spec) const
+    {
+        if (not spec.is_string() or spec.dict_type or spec.array_type) return false;
+        const std::string_view name = spec.get<varlink::detail::string_type>();
+        return primitive_types.count(name) == 0 and complete_types_.count(name) == 0
+               and interface_.has_type(name) and not interface_.type(name).data.is_enum();
+    }
+
+    // Named types used by a struct's fields, including those of its anonymous structs
+    void collect_dependencies(const type_spec& spec, std::vector<std::string_view>& deps) const
+    {
+        if (spec.is_string()) {
+            const std::string_view name = spec.get<varlink::detail::string_type>();
+            if (primitive_types.count(name) == 0) { deps.push_back(name); }
+        }
+        else if (spec.is_struct()) {
+            for (const auto& field : spec.get<vl_struct>()) {
+                collect_dependencies(field.second, deps);
+            }
+        }
+    }
+
+    // Struct types are written after the ones they depend on. Cycles can only be built
+    // with maybe fields, which hold the types of the cycle that are still incomplete by
+    // std::unique_ptr, see is_incomplete. Arrays and dicts are fine with the forward
+    // declarations.
+    void write_type(std::string_view name)
+    {
+        if (not written_types_.insert(name).second) return;
+        if (not interface_.has_type(name)) {
+            throw std::invalid_argument("Unknown type: " + std::string(name));
+        }
+        const auto& spec = interface_.type(name).data;
+        if (spec.is_enum()) return;
+        std::vector<std::string_view> deps;
+        collect_dependencies(spec, deps);
+        for (const auto dep : deps) {
+            write_type(dep);
+        }
+        out_ << "\n";
+        write_struct(0, identifier(name), spec);
+        complete_types_.insert(name);
+    }
+
+    void write_enum(int indent, const std::string& name, const vl_enum& values, const char* linkage)
+    {
+        const auto i = indent;
+        std::string enumerators;
+        for (const auto& value : values) {
+            if (not enumerators.empty()) { enumerators += ", "; }
+            enumerators += identifier(value);
+        }
+        line(i, "enum class " + name + " { " + enumerators + " };");
+        line(i, "");
+        line(
+            i, std::string(linkage) + "void to_json(::varlink::json& j, const " + name + "& v)");
+        line(i, "{");
+        line(i + 1, "switch (v) {");
+        for (const auto& value : values) {
+            line(
+                i + 2,
+                "case " + name + "::" + identifier(value) + ": j = \"" + std::string(value)
+                    + "\"; return;");
+        }
+        line(i + 1, "}");
+        line(i + 1, "j = nullptr;");
+        line(i, "}");
+        line(i, "");
+        line(
+            i,
+            std::string(linkage) + "void from_json(const ::varlink::json& j, " + name + "& v)");
+        line(i, "{");
+        line(i + 1, "if (j.is_string()) {");
+        line(i + 2, "const auto& s = j.get_ref<const std::string&>();");
+        for (const auto& value : values) {
+            line(
+                i + 2,
+                "if (s == \"" + std::string(value) + "\") { v = " + name + "::" + identifier(value)
+                    + "; return; }");
+        }
+        line(i + 1, "}");
+        line(i + 1, "throw ::varlink::invalid_parameter(j.dump());");
+        line(i, "}");
+    }
+
+    void write_struct(int indent, const std::string& name, const type_spec& spec)
+    {
+        const auto i = indent;
+        const auto empty = vl_struct{};
+        const auto& fields = spec.is_struct() ? spec.get<vl_struct>() : empty;
+        const auto field_name = [&](std::string_view field) {
+            auto id = identifier(field);
+            return (id == name) ? id + "_" : id;
+        };
+
+        line(i, "struct " + name + " {");
+        for (const auto& [field, type] : fields) {
+            if (type.is_enum()) {
+                write_enum(i + 1, field_name(field) + "_type", type.get<vl_enum>(), "friend ");
+                line(i, "");
+            }
+            else if (is_anonymous(type)) {
+                write_struct(i + 1, field_name(field) + "_type", type);
+                line(i, "");
+            }
+        }
+        for (const auto& [field, type] : fields) {
+            line(i + 1, cxx_type(type, field_name(field)) + " " + field_name(field) + "{};");
+        }
+        if (not fields.empty()) { line(i, ""); }
+        line(
+            i + 1,
+            "friend void to_json(::varlink::json& j, [[maybe_unused]] const " + name + "& v)");
+        line(i + 1, "{");
+        line(i + 2, "::varlink::json::object_t o;");
+        for (const auto& [field, type] : fields) {
+            line(
+                i + 2,
+                "::varlink::detail::encode_field(o, \"" + std::string(field) + "\", v."
+                    + field_name(field) + ");");
+        }
+        line(i + 2, "j = std::move(o);");
+        line(i + 1, "}");
+        line(i, "");
+        // Also called with a mutable json, to move out of it
+        line(i + 1, "template <typename Json>");
+        line(i + 1, "friend void from_json(Json& j, [[maybe_unused]] " + name + "& v)");
+        line(i + 1, "{");
+        line(i + 2, "::varlink::detail::expect_object(j);");
+        for (const auto& [field, type] : fields) {
+            line(
+                i + 2,
+                "::varlink::detail::decode_field(j, \"" + std::string(field) + "\", v."
+                    + field_name(field) + ");");
+        }
+        line(i + 1, "}");
+        line(i, "};");
+    }
+
+    void write_server()
+    {
+        out_ << "\n";
+        line(0, "// Derive from it and override the methods the service implements. The others");
+        line(0, "// reply with org.varlink.service.MethodNotImplemented.");
+        line(0, "class server {");
+        line(0, "  public:");
+        line(1, "virtual ~server() = default;");
+        interface_.for_each_method([&](const member& m) {
+            const auto type = qualified(m.name);
+            line(0, "");
+            line(1, "virtual void " + identifier(m.name) + "(");
+            line(2, "[[maybe_unused]] " + type + "::parameters parameters,");
+            line(2, "[[maybe_unused]] ::varlink::callmode mode,");
+            line(
+                2,
+                "[[maybe_unused]] const ::varlink::typed_reply<" + type
+                    + "::reply>& send_reply)");
+            line(1, "{");
+            line(2, "throw std::bad_function_call{};");
+            line(1, "}");
+        });
+        line(0, "");
+        line(1, "[[nodiscard]] ::varlink::callback_map callbacks()");
+        line(1, "{");
+        line(2, "return {");
+        interface_.for_each_method([&](const member& m) {
+            const auto type = qualified(m.name);
+            line(3, "{\"" + std::string(m.name) + "\",");
+            line(3, " ::varlink::consuming_callback([this](");
+            line(5, " auto&& parameters,");
+            line(5, " ::varlink::callmode mode,");
+            line(5, " const ::varlink::reply_function& send_reply) {");
+            line(4, " " + identifier(m.name) + "(");
+            line(5, " ::varlink::decode_typed<" + type + "::parameters>(");
+            line(6, " std::forward<decltype(parameters)>(parameters)),");
+            line(5, " mode,");
+            line(5, " ::varlink::typed_reply<" + type + "::reply>(send_reply));");
+            line(3, " })},");
+        });
+        line(2, "};");
+        line(1, "}");
+        line(0, "");
+        line(1, "// The callbacks check the types on their own, no validation needed");
+        line(1, "template <typename Service>");
+        line(1, "void add_to(Service& service)");
+        line(1, "{");
+        line(
+            2,
+            "service.add_interface(::varlink::" + constant_
+                + "_interface(), callbacks(), ::varlink::validation::none);");
+        line(1, "}");
+        line(0, "};");
+    }
+
+    void write_client()
+    {
+        out_ << "\n";
+        line(0, "// Replies that don't match the interface throw varlink::invalid_parameter, or");
+        line(0, "// complete asynchronous calls with std::errc::invalid_argument.");
+        line(0, "template <typename Client>");
+        line(0, "class client {");
+        line(0, "  public:");
+        line(1, "explicit client(Client& c) : client_(c) {}");
+        interface_.for_each_method([&](const member& m) {
+            const auto name = identifier(m.name);
+            const auto type = qualified(m.name);
+            line(0, "");
+            line(1, type + "::reply " + name + "(const " + type + "::parameters& parameters)");
+            line(1, "{");
+            line(2, "return ::varlink::decode_typed<" + type + "::reply>(");
+            line(
+                3,
+                "client_.call(" + type
+                    + "::name, ::varlink::json(::varlink::encode_typed(parameters))));");
+            line(1, "}");
+            line(0, "");
+            line(1, "// Returns std::nullopt after the last reply");
+            line(1, "std::function<std::optional<" + type + "::reply>()> " + name + "_more(");
+            line(2, "const " + type + "::parameters& parameters)");
+            line(1, "{");
+            line(2, "auto next = client_.call_more(");
+            line(3, type + "::name, ::varlink::json(::varlink::encode_typed(parameters)));");
+            line(
+                2,
+                "return [next = std::move(next)]() mutable -> std::optional<" + type
+                    + "::reply> {");
+            line(3, "auto reply = next();");
+            line(3, "if (reply.is_null()) return std::nullopt;");
+            line(3, "return ::varlink::decode_typed<" + type + "::reply>(reply);");
+            line(2, "};");
+            line(1, "}");
+            line(0, "");
+            line(1, "// Calls handler(std::error_code, " + type + "::reply)");
+            line(1, "template <typename ReplyHandler>");
+            line(
+                1,
+                "void async_" + name + "(const " + type
+                    + "::parameters& parameters, ReplyHandler&& handler)");
+            line(1, "{");
+            line(2, "client_.async_call(");
+            line(3, type + "::name,");
+            line(3, "::varlink::json(::varlink::encode_typed(parameters)),");
+            line(3, "[handler = std::forward<ReplyHandler>(handler)](");
+            line(4, "std::error_code ec, const ::varlink::json& reply_parameters) mutable {");
+            line(4, type + "::reply reply{};");
+            line(4, "if (not ec) {");
+            line(5, "try {");
+            line(6, "from_json(reply_parameters, reply);");
+            line(5, "}");
+            line(5, "catch (const ::varlink::invalid_parameter&) {");
+            line(6, "ec = std::make_error_code(std::errc::invalid_argument);");
+            line(5, "}");
+            line(4, "}");
+            line(4, "handler(ec, std::move(reply));");
+            line(3, "});");
+            line(1, "}");
+        });
+        line(0, "");
+        line(0, "  private:");
+        line(1, "Client& client_;");
+        line(0, "};");
+    }
+};
+
+// Control characters are written as octal escapes, which unlike \x escapes end after
+// three digits
+std::string literal(std::string_view text)
+{
+    std::string s = "\"";
+    for (const char c : text) {
+        const auto u = static_cast<unsigned char>(c);
+        if (c == '\n') { s += "\\n"; }
+        else if (c == '"' or c == '\\') {
+            s += '\\';
+            s += c;
+        }
+        else if (u < 0x20 or u == 0x7f) {
+            s += '\\';
+            s += static_cast<char>('0' + ((u >> 6) & 7));
+            s += static_cast<char>('0' + ((u >> 3) & 7));
+            s += static_cast<char>('0' + (u & 7));
+        }
+        else {
+            s += c;
+        }
+    }
+    return s + "\"";
+}
+
+// The type_spec exactly as the scanner produced it, so the table prints the same
+// description and compiles to the same validators
+std::string table_initializer(const type_spec& spec, int indent) // NOLINT(misc-no-recursion)
+{
+    const auto spaces = std::string(static_cast<size_t>(indent) * 4, ' ');
+    std::string type;
+    if (spec.is_string()) {
+        type = "string_type(" + literal(spec.get<varlink::detail::string_type>()) + ")";
+    }
+    else if (spec.is_enum()) {
+        type = "vl_enum{";
+        for (const auto& value : spec.get<vl_enum>()) {
+            type += literal(value) + ", ";
+        }
+        type += "}";
+    }
+    else if (spec.is_struct() and spec.get<vl_struct>().empty()) {
+        type = "vl_struct{}";
+    }
+    else if (spec.is_struct()) {
+        type = "vl_struct{\n";
+        for (const auto& [field, field_spec] : spec.get<vl_struct>()) {
+            type += spaces + "    {" + literal(field) + ", "
+                    + table_initializer(field_spec, indent + 1) + "},\n";
+        }
+        type += spaces + "}";
+    }
+    else {
+        type = "type_def{}";
+    }
+    if (not(spec.maybe_type or spec.dict_type or spec.array_type)) {
+        return "type_spec(" + type + ")";
+    }
+    const auto flag = [](bool b) { return b ? "true" : "false"; };
+    return "type_spec(" + type + ", " + flag(spec.maybe_type) + ", " + flag(spec.dict_type) + ", "
+           + flag(spec.array_type) + ")";
+}
+
+std::string table(const varlink::varlink_interface& interface, const std::string& constant)
+{
+    static constexpr std::array<std::string_view, 4> kinds{
+        "MemberKind::Undefined", "MemberKind::Type", "MemberKind::Error", "MemberKind::Method"};
+    std::string s;
+    s += "\n// Parsed by varlink-codegen at build time\n";
+    s += "inline varlink_interface " + constant + "_interface()\n{\n";
+    s += "    using namespace detail;\n";
+    s += "    return varlink_interface(\n";
+    s += "        " + literal(interface.name()) + ",\n";
+    s += "        " + literal(interface.doc()) + ",\n";
+    s += "        {\n";
+    interface.for_each_member([&](const member& m) {
+        s += "            member(\n";
+        s += "                " + std::string(kinds.at(static_cast<size_t>(m.kind))) + ",\n";
+        s += "                " + literal(m.name) + ",\n";
+        s += "                " + literal(m.description) + ",\n";
+        s += "                " + table_initializer(m.data, 4) + "),\n";
+    });
+    s += "        });\n}\n";
+    return s;
+}
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream file(path);
+    if (not file) throw std::runtime_error("Can't open " + path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const bool typed = (argc == 4 and std::string_view(argv[1]) == "--typed");
+    if (argc != 3 and not typed) {
+        std::cerr << "Usage: varlink-codegen [--typed] <in-file> <out-file>\n";
+        return 1;
+    }
+    try {
+        const std::string in_path = argv[argc - 2];
+        const std::string out_path = argv[argc - 1];
+        const auto description = read_file(in_path);
+        const auto interface = varlink::varlink_interface(description);
+
+        // Same constant and guard names as cmake/varlink-wrapper.cmake
+        auto constant = in_path.substr(in_path.find_last_of('/') + 1);
+        std::replace(constant.begin(), constant.end(), '.', '_');
+        auto guard = constant + "_H";
+        std::transform(guard.begin(), guard.end(), guard.begin(), [](unsigned char c) {
+            return static_cast<char>(std::toupper(c));
+        });
+
+        std::ostringstream header;
+        header << "#ifndef " << guard << "\n#define " << guard << "\n";
+        if (typed) { header << "#include <cstdint>\n"; }
+        header << "#include <string_view>\n";
+        header << (typed ? "#include <varlink/typed.hpp>\n" : "#include <varlink/interface.hpp>\n");
+        header << "namespace varlink {\n";
+        header << "inline constexpr const std::string_view " << constant << " = R\"INTERFACE(\n"
+               << description << ")INTERFACE\";\n";
+        header << table(interface, constant);
+        header << "} // namespace varlink\n";
+        if (typed) { header << "\n" << generator(interface, constant).generate(); }
+        header << "#endif // " << guard << "\n";
+
+        if (const auto dir = std::filesystem::path(out_path).parent_path(); not dir.empty()) {
+            std::filesystem::create_directories(dir);
+        }
+        std::ofstream out(out_path);
+        out << header.str();
+        if (not out) throw std::runtime_error("Can't write " + out_path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "varlink-codegen: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,7 +1,12 @@
 #ifndef LIBVARLINK_ASYNC_CLIENT_HPP
 #define LIBVARLINK_ASYNC_CLIENT_HPP
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <variant>
+#include <varlink/detail/manual_strand.hpp>
 #include <varlink/detail/message.hpp>
 #include <varlink/detail/varlink_error.hpp>
 #include <varlink/json_connection.hpp>
@@ -54,6 +59,40 @@ class async_client {
 
     bool is_open() { return connection.is_open(); }
 
+    [[nodiscard]] size_t max_message_size() const noexcept { return connection.max_message_size(); }
+    void set_max_message_size(size_t size) noexcept { connection.set_max_message_size(size); }
+
+    // By default, a call is only sent after the reply to the previous call was received.
+    // A pipelined client sends every call right away and matches the replies to the calls
+    // in order, so many calls can be in flight on one connection. Completion handlers may
+    // then be called from different threads if the executor runs on several. Must be set
+    // before the first asynchronous call, synchronous calls are unaffected. Disabling it
+    // while pipelined calls are in flight throws std::logic_error.
+    [[nodiscard]] bool pipelined() const noexcept { return pipeline_ != nullptr; }
+    void set_pipelined(bool enable)
+    {
+        if (enable and not pipeline_) { pipeline_ = std::make_unique<pipeline_state>(); }
+        else if (not enable and pipeline_) {
+            {
+                std::lock_guard lock(pipeline_->mutex);
+                if (pipeline_->reading or pipeline_->sending > 0) {
+                    throw std::logic_error("async_client: pipelined calls are in flight");
+                }
+            }
+            pipeline_.reset();
+        }
+    }
+
+    // True while asynchronous calls are in flight or their sends haven't completed. Those
+    // refer to the client, so it must not be destroyed or replaced before.
+    [[nodiscard]] bool busy()
+    {
+        if (connection.sending() or not call_strand.idle()) { return true; }
+        if (not pipeline_) { return false; }
+        std::lock_guard lock(pipeline_->mutex);
+        return pipeline_->reading or pipeline_->sending > 0;
+    }
+
     template <typename ReplyHandler>
     auto async_call(const varlink_message& message, ReplyHandler&& handler)
     {
@@ -145,6 +184,24 @@ class async_client {
     connection_type connection;
     detail::manual_strand<executor_type> call_strand;
 
+    struct pending_reply {
+        detail::unique_function<void(std::error_code, const json&, bool)> handler;
+        bool more;
+    };
+    // Calls may be started from any thread. Sending a call and queueing its reply handler
+    // happens under the mutex, so pending_replies is in the same order as the calls on the
+    // wire. Only the front entry is used and popped by the read loop, which runs as long as
+    // pending_replies isn't empty. The read loop is only re-armed under the mutex and after
+    // checking send_ec, so a failed send either cancels the armed read or is seen by it.
+    struct pipeline_state {
+        std::mutex mutex{};
+        std::deque<pending_reply> pending_replies{};
+        std::error_code send_ec{};
+        size_t sending{0}; // sends of calls with replies whose completion hasn't run yet
+        bool reading{false};
+    };
+    std::unique_ptr<pipeline_state> pipeline_{};
+
     std::function<json()> call_impl(const basic_varlink_message& message)
     {
         connection.send(message.json_data());
@@ -160,7 +217,7 @@ class async_client {
                 if (mode != callmode::more or not reply_continues(reply)) {
                     mode = callmode::oneway;
                 }
-                return reply["parameters"];
+                return std::move(reply["parameters"]);
             }
         };
     }
@@ -191,6 +248,91 @@ class async_client {
             });
     }
 
+    template <callmode CallMode, typename ReplyHandler>
+    void async_call_pipelined(const basic_varlink_message& message, ReplyHandler&& handler)
+    {
+        auto& p = *pipeline_;
+        std::lock_guard lock(p.mutex);
+        if constexpr (CallMode == callmode::oneway) {
+            connection.async_send(message.json_data(), std::forward<ReplyHandler>(handler));
+        }
+        else {
+            ++p.sending;
+            connection.async_send(message.json_data(), [this](std::error_code ec) {
+                {
+                    std::lock_guard send_lock(pipeline_->mutex);
+                    --pipeline_->sending;
+                    if (not ec) { return; }
+                    if (not pipeline_->send_ec) { pipeline_->send_ec = ec; }
+                }
+                // The reply will never arrive. Abort the read loop if it waits on the
+                // socket, otherwise it sees send_ec before reading again. Either way, it
+                // fails all pending calls with this error.
+                connection.cancel();
+            });
+            if constexpr (CallMode == callmode::more) {
+                p.pending_replies.push_back({std::forward<ReplyHandler>(handler), true});
+            }
+            else {
+                p.pending_replies.push_back(
+                    {[handler = std::forward<ReplyHandler>(handler)](
+                         std::error_code ec, const json& parameters, bool) mutable {
+                         handler(ec, parameters);
+                     },
+                     false});
+            }
+            if (not p.reading) {
+                p.reading = true;
+                async_read_pipelined();
+            }
+        }
+    }
+
+    void async_read_pipelined()
+    {
+        connection.async_receive([this](std::error_code ec, json reply) {
+            auto& p = *pipeline_;
+            if (ec) { return fail_pipelined(ec); }
+            if (reply.contains("error")) {
+                ec = make_varlink_error(reply["error"].get<std::string>());
+            }
+            pending_reply* pending{};
+            {
+                std::lock_guard lock(p.mutex);
+                pending = &p.pending_replies.front();
+            }
+            // New calls only append to the deque, so the front entry stays valid
+            const auto continues = (pending->more and not ec and reply_continues(reply));
+            pending->handler(ec, reply["parameters"], continues);
+            {
+                std::lock_guard lock(p.mutex);
+                if (not continues) { p.pending_replies.pop_front(); }
+                ec = p.send_ec;
+                if (not ec) {
+                    p.reading = not p.pending_replies.empty();
+                    if (p.reading) { async_read_pipelined(); }
+                    return;
+                }
+            }
+            fail_pipelined(ec);
+        });
+    }
+
+    void fail_pipelined(std::error_code ec)
+    {
+        auto& p = *pipeline_;
+        std::deque<pending_reply> failed{};
+        {
+            std::lock_guard lock(p.mutex);
+            failed.swap(p.pending_replies);
+            if (p.send_ec) { ec = std::exchange(p.send_ec, std::error_code{}); }
+            p.reading = false;
+        }
+        for (auto& pending : failed) {
+            pending.handler(ec, json{}, false);
+        }
+    }
+
     template <callmode CallMode>
     class initiate_async_call {
       private:
@@ -202,6 +344,10 @@ class async_client {
         template <typename CompletionHandler>
         void operator()(CompletionHandler&& handler, const typed_varlink_message<CallMode>& message)
         {
+            if (self_->pipeline_) {
+                return self_->template async_call_pipelined<CallMode>(
+                    message, std::forward<CompletionHandler>(handler));
+            }
             self_->call_strand.push(
                 [self = self_, message, handler = std::forward<CompletionHandler>(handler)]() mutable {
                     self->connection.async_send(
@@ -1,8 +1,12 @@
 #ifndef LIBVARLINK_ASYNC_SERVER_HPP
 #define LIBVARLINK_ASYNC_SERVER_HPP
 
+#include <stdexcept>
 #include <variant>
+#include <sys/socket.h>
 #include <experimental/filesystem>
+#include <varlink/detail/counter.hpp>
+#include <varlink/detail/probes.hpp>
 #include <varlink/server_session.hpp>
 
 namespace varlink {
@@ -19,9 +23,25 @@ class async_server : public std::enable_shared_from_this<async_server<Protocol>>
 
     executor_type get_executor() { return acceptor_.get_executor(); }
 
+    // Applied to the sessions accepted afterwards, those already running keep their depth
+    // (see server_session::set_pipeline_depth). May be set while the server is running.
+    [[nodiscard]] size_t pipeline_depth() const noexcept { return pipeline_depth_.load(); }
+    void set_pipeline_depth(size_t depth) noexcept { pipeline_depth_.store(depth); }
+
+    // Accepted sockets are bound to the executor returned by the selector, e.g. to spread
+    // sessions across several io_contexts. By default, they use the acceptor's executor.
+    using executor_selector = std::function<typename socket_type::executor_type()>;
+    void set_session_executor(executor_selector selector)
+    {
+        session_executor_ = std::move(selector);
+    }
+
   private:
     acceptor_type acceptor_;
     varlink_service& service_;
+    // Read by the accept handlers, which may run on other threads
+    detail::atomic_value<size_t> pipeline_depth_{1};
+    executor_selector session_executor_{};
 
   public:
     explicit async_server(acceptor_type acceptor, varlink_service& service)
@@ -41,13 +61,13 @@ class async_server : public std::enable_shared_from_this<async_server<Protocol>>
             async_accept_initiator(this), handler);
     }
 
-    void async_serve_forever()
+    // Keeps concurrent_accepts accept operations in flight, so a burst of new connections
+    // doesn't wait for each accept to complete before the next one is started.
+    void async_serve_forever(size_t concurrent_accepts = 1)
     {
-        async_accept([this](auto ec, auto session) {
-            if (ec) { return; }
-            session->start();
-            async_serve_forever();
-        });
+        for (size_t i = 0; i < std::max<size_t>(concurrent_accepts, 1); i++) {
+            async_accept_loop();
+        }
     }
 
     ~async_server()
@@ -59,6 +79,15 @@ class async_server : public std::enable_shared_from_this<async_server<Protocol>>
     }
 
   private:
+    void async_accept_loop()
+    {
+        async_accept([this](auto ec, auto session) {
+            if (ec) { return; }
+            session->start();
+            async_accept_loop();
+        });
+    }
+
     class async_accept_initiator {
       private:
         async_server* self_;
@@ -69,19 +98,84 @@ class async_server : public std::enable_shared_from_this<async_server<Protocol>>
         template <typename ConnectionHandler>
         void operator()(ConnectionHandler&& handler)
         {
-            self_->acceptor_.async_accept(
-                [self = self_, handler_ = std::forward<ConnectionHandler>(handler)](
-                    std::error_code ec, socket_type socket) mutable {
-                    std::shared_ptr<session_type> session{};
-                    if (!ec) {
-                        session = std::make_shared<session_type>(std::move(socket), self->service_);
-                    }
-                    handler_(ec, std::move(session));
-                });
+            auto on_accept = [self = self_, handler_ = std::forward<ConnectionHandler>(handler)](
+                                 std::error_code ec, socket_type socket) mutable {
+                std::shared_ptr<session_type> session{};
+                if (!ec) {
+                    session = std::make_shared<session_type>(std::move(socket), self->service_);
+                    session->set_pipeline_depth(self->pipeline_depth_.load());
+                    VARLINK_PROBE1(session_accept, session.get());
+                }
+                handler_(ec, std::move(session));
+            };
+            if (self_->session_executor_) {
+                self_->acceptor_.async_accept(self_->session_executor_(), std::move(on_accept));
+            }
+            else {
+                self_->acceptor_.async_accept(std::move(on_accept));
+            }
         }
     };
 };
 
+// SO_REUSEPORT lets several acceptors listen on the same endpoint, the kernel then
+// distributes incoming connections among them. Implements asio's GettableSocketOption
+// and SettableSocketOption requirements.
+class reuse_port {
+  public:
+    explicit reuse_port(bool enabled = false) noexcept : value_(enabled ? 1 : 0) {}
+
+    [[nodiscard]] bool value() const noexcept { return value_ != 0; }
+
+    template <typename Protocol>
+    [[nodiscard]] int level(const Protocol&) const noexcept
+    {
+        return SOL_SOCKET;
+    }
+    template <typename Protocol>
+    [[nodiscard]] int name(const Protocol&) const noexcept
+    {
+        return SO_REUSEPORT;
+    }
+    template <typename Protocol>
+    [[nodiscard]] int* data(const Protocol&) noexcept
+    {
+        return &value_;
+    }
+    template <typename Protocol>
+    [[nodiscard]] const int* data(const Protocol&) const noexcept
+    {
+        return &value_;
+    }
+    template <typename Protocol>
+    [[nodiscard]] size_t size(const Protocol&) const noexcept
+    {
+        return sizeof(value_);
+    }
+    template <typename Protocol>
+    void resize(const Protocol&, size_t size) const
+    {
+        if (size != sizeof(value_)) { throw std::length_error("reuse_port socket option resize"); }
+    }
+
+  private:
+    int value_;
+};
+
+template <typename Executor>
+net::ip::tcp::acceptor make_reuse_port_acceptor(
+    const Executor& executor,
+    const net::ip::tcp::endpoint& endpoint)
+{
+    net::ip::tcp::acceptor acceptor{executor};
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(net::ip::tcp::acceptor::reuse_address(true));
+    acceptor.set_option(reuse_port(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    return acceptor;
+}
+
 using async_server_unix = async_server<net::local::stream_protocol>;
 using async_server_tcp = async_server<net::ip::tcp>;
 using async_server_variant = std::variant<async_server_unix, async_server_tcp>;
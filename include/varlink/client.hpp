@@ -110,6 +110,20 @@ class varlink_client {
         return std::visit([](auto& c) { return c.is_open(); }, *client);
     }
 
+    [[nodiscard]] bool pipelined() const
+    {
+        return std::visit([](const auto& c) { return c.pipelined(); }, *client);
+    }
+    void set_pipelined(bool enable)
+    {
+        std::visit([enable](auto& c) { c.set_pipelined(enable); }, *client);
+    }
+
+    [[nodiscard]] bool busy()
+    {
+        return client and std::visit([](auto& c) { return c.busy(); }, *client);
+    }
+
     template <typename... Args>
     auto async_call(Args&&... args)
     {
@@ -0,0 +1,318 @@
+#ifndef LIBVARLINK_CLIENT_POOL_HPP
+#define LIBVARLINK_CLIENT_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <varlink/client.hpp>
+
+namespace varlink {
+// Shares connections to any number of endpoints between threads, keyed by their varlink uri.
+// A synchronous call leases an idle connection for its round-trip. Asynchronous calls are
+// pipelined on the connection with the fewest calls in flight. Connections are opened on
+// demand, up to max_connections per endpoint, calls beyond that wait for one to become
+// available. A connection that failed is replaced by a new one, it is only destroyed once
+// its calls completed and its client has nothing pending anymore.
+// Asynchronous calls connect asynchronously and wait for the connect to complete, only
+// synchronous calls connect synchronously. Completion handlers run on the pool's executor
+// and must not block on synchronous calls of the same pool. The pool must outlive all calls.
+class varlink_client_pool {
+  public:
+    static constexpr size_t default_max_connections = 8;
+
+  private:
+    struct pooled_connection {
+        varlink_client client;
+        size_t in_flight{0};
+        // Leased to a synchronous call or being connected
+        bool exclusive{false};
+        bool retired{false};
+
+        explicit pooled_connection(const asio::any_io_executor& ex) : client(ex) {}
+    };
+
+    // Lists, so connections keep their address when they are retired or destroyed
+    struct endpoint_pool {
+        std::string uri;
+        std::list<pooled_connection> connections{};
+        std::list<pooled_connection> retired{};
+        std::deque<detail::unique_function<void()>> waiting{};
+    };
+
+    struct lease {
+        endpoint_pool& endpoint;
+        pooled_connection& connection;
+        bool connect;
+    };
+
+    asio::any_io_executor ex_;
+    size_t max_connections_;
+    std::mutex mutex{};
+    std::condition_variable available{};
+    std::map<std::string, endpoint_pool, std::less<>> endpoints{};
+
+  public:
+    explicit varlink_client_pool(
+        asio::any_io_executor ex, size_t max_connections = default_max_connections)
+        : ex_(std::move(ex)), max_connections_(std::max<size_t>(max_connections, 1))
+    {
+    }
+
+    template <
+        typename ExecutionContext,
+        typename = std::enable_if_t<std::is_convertible_v<ExecutionContext&, asio::execution_context&>>>
+    explicit varlink_client_pool(
+        ExecutionContext& ctx, size_t max_connections = default_max_connections)
+        : varlink_client_pool(ctx.get_executor(), max_connections)
+    {
+    }
+
+    varlink_client_pool(const varlink_client_pool&) = delete;
+    varlink_client_pool& operator=(const varlink_client_pool&) = delete;
+    varlink_client_pool(varlink_client_pool&&) = delete;
+    varlink_client_pool& operator=(varlink_client_pool&&) = delete;
+
+    [[nodiscard]] asio::any_io_executor get_executor() const { return ex_; }
+    [[nodiscard]] size_t max_connections() const noexcept { return max_connections_; }
+
+    [[nodiscard]] size_t connection_count(std::string_view uri)
+    {
+        std::lock_guard lock(mutex);
+        const auto it = endpoints.find(uri);
+        return (it == endpoints.end()) ? 0 : it->second.connections.size();
+    }
+
+    json call(std::string_view uri, const varlink_message& message)
+    {
+        auto l = lease_exclusive(uri);
+        try {
+            if (l.connect) { connect(l); }
+            auto reply = l.connection.client.call(message);
+            release(l, false);
+            return reply;
+        }
+        catch (varlink_error&) {
+            release(l, false);
+            throw;
+        }
+        catch (...) {
+            release(l, true);
+            throw;
+        }
+    }
+
+    json call(std::string_view uri, std::string_view method, const json& parameters)
+    {
+        return call(uri, varlink_message(method, parameters));
+    }
+
+    template <typename ReplyHandler>
+    auto async_call(std::string_view uri, const varlink_message& message, ReplyHandler&& handler)
+    {
+        return net::async_initiate<ReplyHandler, void(std::error_code, json)>(
+            initiate_async_call(this), handler, std::string(uri), message);
+    }
+
+    template <typename ReplyHandler>
+    auto async_call(
+        std::string_view uri,
+        std::string_view method,
+        const json& parameters,
+        ReplyHandler&& handler)
+    {
+        return async_call(
+            uri, varlink_message(method, parameters), std::forward<ReplyHandler>(handler));
+    }
+
+  private:
+    // Requires mutex
+    endpoint_pool& get_endpoint(std::string_view uri)
+    {
+        if (auto it = endpoints.find(uri); it != endpoints.end()) { return it->second; }
+        (void)varlink_uri(uri); // Reject bad uris before they are added
+        auto& endpoint = endpoints[std::string(uri)];
+        endpoint.uri = std::string(uri);
+        return endpoint;
+    }
+
+    lease lease_exclusive(std::string_view uri)
+    {
+        std::unique_lock lock(mutex);
+        auto& endpoint = get_endpoint(uri);
+        while (true) {
+            destroy_retired(endpoint);
+            for (auto& c : endpoint.connections) {
+                if (c.in_flight > 0 or c.exclusive) continue;
+                c.exclusive = true;
+                return {endpoint, c, false};
+            }
+            if (endpoint.connections.size() < max_connections_) {
+                auto& c = endpoint.connections.emplace_back(ex_);
+                c.exclusive = true;
+                return {endpoint, c, true};
+            }
+            available.wait(lock);
+        }
+    }
+
+    // Requires mutex. Returns nullptr if the call has to wait.
+    pooled_connection* lease_shared(endpoint_pool& endpoint, bool& connect)
+    {
+        pooled_connection* least_busy{nullptr};
+        for (auto& c : endpoint.connections) {
+            if (c.exclusive) continue;
+            if (not least_busy or c.in_flight < least_busy->in_flight) least_busy = &c;
+        }
+        if (least_busy and least_busy->in_flight == 0) { return least_busy; }
+        if (endpoint.connections.size() < max_connections_) {
+            auto& c = endpoint.connections.emplace_back(ex_);
+            c.exclusive = connect = true;
+            return &c;
+        }
+        return least_busy;
+    }
+
+    // Requires mutex. Moves a failed connection out of the pool, so that a new one takes
+    // its place. Its pending operations refer to its client, which is therefore never
+    // reconnected in place.
+    void retire(endpoint_pool& endpoint, pooled_connection& connection)
+    {
+        if (connection.retired) return;
+        connection.retired = true;
+        for (auto it = endpoint.connections.begin(); it != endpoint.connections.end(); ++it) {
+            if (&*it == &connection) {
+                endpoint.retired.splice(endpoint.retired.end(), endpoint.connections, it);
+                return;
+            }
+        }
+    }
+
+    // Requires mutex
+    void destroy_retired(endpoint_pool& endpoint)
+    {
+        endpoint.retired.remove_if([](pooled_connection& c) {
+            return c.in_flight == 0 and not c.exclusive and not c.client.busy();
+        });
+    }
+
+    // Called with an exclusive lease, so nobody else uses the connection
+    void connect(const lease& l)
+    {
+        l.connection.client.connect(varlink_uri(l.endpoint.uri));
+        l.connection.client.set_pipelined(true);
+    }
+
+    void release(const lease& l, bool failed)
+    {
+        {
+            std::lock_guard lock(mutex);
+            l.connection.exclusive = false;
+            if (failed) { retire(l.endpoint, l.connection); }
+        }
+        resume_waiting(l.endpoint);
+    }
+
+    // Runs the calls waiting for a connection. The ones still without a connection queue
+    // themselves up again.
+    void resume_waiting(endpoint_pool& endpoint)
+    {
+        std::deque<detail::unique_function<void()>> waiting{};
+        {
+            std::lock_guard lock(mutex);
+            waiting.swap(endpoint.waiting);
+        }
+        available.notify_all();
+        for (auto& resume : waiting) {
+            resume();
+        }
+    }
+
+    template <typename ReplyHandler>
+    void start_async_call(std::string uri, const varlink_message& message, ReplyHandler handler)
+    {
+        std::unique_lock lock(mutex);
+        auto& endpoint = get_endpoint(uri);
+        destroy_retired(endpoint);
+        bool connect{false};
+        auto* connection = lease_shared(endpoint, connect);
+        if (not connection) {
+            endpoint.waiting.emplace_back(
+                [this, uri = std::move(uri), message, handler = std::move(handler)]() mutable {
+                    start_async_call(std::move(uri), message, std::move(handler));
+                });
+            return;
+        }
+        ++connection->in_flight;
+        lock.unlock();
+
+        if (not connect) {
+            return send_async_call(endpoint, *connection, message, std::move(handler));
+        }
+        // The call holds the exclusive lease until the connection is open
+        connection->client.async_connect(
+            varlink_uri(endpoint.uri),
+            [this, &endpoint, connection, message, handler = std::move(handler)](
+                std::error_code ec) mutable {
+                if (not ec) { connection->client.set_pipelined(true); }
+                {
+                    std::lock_guard connect_lock(mutex);
+                    connection->exclusive = false;
+                    if (ec) {
+                        --connection->in_flight;
+                        retire(endpoint, *connection);
+                    }
+                }
+                // The call that opened the connection is sent first. The calls that waited
+                // for a connection may then use this one, or a new one.
+                if (not ec) { send_async_call(endpoint, *connection, message, std::move(handler)); }
+                resume_waiting(endpoint);
+                if (ec) { handler(ec, json{}); }
+            });
+    }
+
+    template <typename ReplyHandler>
+    void send_async_call(
+        endpoint_pool& endpoint,
+        pooled_connection& connection,
+        const varlink_message& message,
+        ReplyHandler handler)
+    {
+        connection.client.async_call(
+            message,
+            [this, &endpoint, &connection, handler = std::move(handler)](
+                std::error_code ec, const json& reply) mutable {
+                // Varlink errors are regular replies, everything else breaks the connection
+                const bool failed = ec and ec.category() != varlink_category();
+                bool idle{false};
+                {
+                    std::lock_guard reply_lock(mutex);
+                    if (failed) { retire(endpoint, connection); }
+                    idle = (--connection.in_flight == 0);
+                }
+                // Once retired, a connection no longer counts towards max_connections
+                if (idle or failed) { resume_waiting(endpoint); }
+                handler(ec, reply);
+            });
+    }
+
+    class initiate_async_call {
+      private:
+        varlink_client_pool* self_;
+
+      public:
+        explicit initiate_async_call(varlink_client_pool* self) : self_(self) {}
+
+        template <typename CompletionHandler>
+        void operator()(
+            CompletionHandler&& handler, std::string uri, const varlink_message& message)
+        {
+            self_->start_async_call(
+                std::move(uri), message, std::forward<CompletionHandler>(handler));
+        }
+    };
+};
+} // namespace varlink
+
+#endif // LIBVARLINK_CLIENT_POOL_HPP
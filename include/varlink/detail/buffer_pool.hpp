@@ -0,0 +1,79 @@
+#ifndef LIBVARLINK_BUFFER_POOL_HPP
+#define LIBVARLINK_BUFFER_POOL_HPP
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <varlink/detail/nl_json.hpp>
+
+namespace varlink::detail {
+// Recycles the strings outgoing messages are serialized into. Every thread keeps its own
+// free list, so neither acquire nor release need a lock. Buffers released on another
+// thread than they were acquired on simply migrate to that thread's list.
+class buffer_pool {
+  public:
+    static constexpr size_t max_buffers = 32;
+    static constexpr size_t max_buffer_capacity = 64 * 1024;
+
+    [[nodiscard]] static std::string acquire()
+    {
+        auto& buffers = free_buffers();
+        if (buffers.empty()) { return {}; }
+        auto buffer = std::move(buffers.back());
+        buffers.pop_back();
+        buffer.clear();
+        return buffer;
+    }
+
+    static void release(std::string&& buffer)
+    {
+        auto& buffers = free_buffers();
+        if (buffers.size() < max_buffers and buffer.capacity() <= max_buffer_capacity) {
+            buffers.push_back(std::move(buffer));
+        }
+    }
+
+  private:
+    static std::vector<std::string>& free_buffers()
+    {
+        thread_local std::vector<std::string> buffers = [] {
+            std::vector<std::string> v;
+            v.reserve(max_buffers);
+            return v;
+        }();
+        return buffers;
+    }
+};
+
+// Appends the same output as message.dump() to out, without allocating a new string.
+// Goes through the public operator<<, with a stream that writes into out.
+inline void dump_into(const json& message, std::string& out)
+{
+    class string_appender : public std::streambuf {
+      public:
+        std::string* target{nullptr};
+
+      protected:
+        int_type overflow(int_type c) override
+        {
+            if (not traits_type::eq_int_type(c, traits_type::eof())) {
+                target->push_back(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char* s, std::streamsize length) override
+        {
+            target->append(s, static_cast<size_t>(length));
+            return length;
+        }
+    };
+
+    thread_local string_appender buffer{};
+    thread_local std::ostream stream(&buffer);
+    buffer.target = &out;
+    stream << message;
+}
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_BUFFER_POOL_HPP
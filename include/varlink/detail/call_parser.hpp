@@ -0,0 +1,175 @@
+#ifndef LIBVARLINK_CALL_PARSER_HPP
+#define LIBVARLINK_CALL_PARSER_HPP
+
+#include <optional>
+#include <vector>
+#include <varlink/detail/message.hpp>
+
+namespace varlink::detail {
+// SAX handler for a varlink call. Picks the method and the call mode flags from the top
+// level object and builds only the parameters as json, straight into the tree that is
+// moved into the message. Unknown members are skipped. Calls that
+// basic_varlink_message(const json&) would reject fail the parse.
+class call_parser {
+  public:
+    using number_integer_t = json::number_integer_t;
+    using number_unsigned_t = json::number_unsigned_t;
+    using number_float_t = json::number_float_t;
+    using string_t = json::string_t;
+    using binary_t = json::binary_t;
+
+    bool null() { return value(nullptr); }
+
+    bool boolean(bool val)
+    {
+        if (depth_ == 1) {
+            switch (member_) {
+                case member::more: more_ = val; return true;
+                case member::oneway: oneway_ = val; return true;
+                case member::upgrade: upgrade_ = val; return true;
+                default: break;
+            }
+        }
+        return value(val);
+    }
+
+    bool number_integer(number_integer_t val) { return value(val); }
+    bool number_unsigned(number_unsigned_t val) { return value(val); }
+    bool number_float(number_float_t val, const string_t&) { return value(val); }
+    bool binary(binary_t& val) { return value(std::move(val)); }
+
+    bool string(string_t& val)
+    {
+        if (depth_ == 1 and member_ == member::method) {
+            method_ = std::move(val);
+            has_method_ = true;
+            return true;
+        }
+        return value(std::move(val));
+    }
+
+    bool start_object(size_t)
+    {
+        if (depth_ == 1 and member_ == member::parameters) {
+            parameters_ = json::object();
+            has_parameters_ = true;
+            stack_.push_back(&parameters_);
+            ++depth_;
+            return true;
+        }
+        if (depth_ == 0) {
+            ++depth_;
+            return true;
+        }
+        return start_container(json::value_t::object);
+    }
+
+    bool end_object() { return end_container(); }
+
+    bool start_array(size_t) { return depth_ > 0 and start_container(json::value_t::array); }
+
+    bool end_array() { return end_container(); }
+
+    bool key(string_t& val)
+    {
+        if (depth_ == 1) {
+            member_ = (val == "method")       ? member::method
+                    : (val == "parameters") ? member::parameters
+                    : (val == "more")       ? member::more
+                    : (val == "oneway")     ? member::oneway
+                    : (val == "upgrade")    ? member::upgrade
+                                            : member::other;
+        }
+        else if (building()) {
+            element_ = &stack_.back()->get_ref<json::object_t&>()[std::move(val)];
+        }
+        return true;
+    }
+
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception&)
+    {
+        return false;
+    }
+
+    // Only valid after json::sax_parse returned true
+    [[nodiscard]] std::optional<basic_varlink_message> message()
+    {
+        if (not has_method_) { return std::nullopt; }
+        const auto mode = more_      ? callmode::more
+                        : oneway_    ? callmode::oneway
+                        : upgrade_   ? callmode::upgrade
+                                     : callmode::basic;
+        return basic_varlink_message(
+            method_, has_parameters_ ? std::move(parameters_) : json{}, mode);
+    }
+
+  private:
+    enum class member { method, parameters, more, oneway, upgrade, other };
+
+    member member_{member::other};
+    // Nesting level of the current value, 1 are the members of the call object
+    size_t depth_{0};
+    // Open containers of the parameters, element_ is the value of their last key
+    std::vector<json*> stack_{};
+    json* element_{nullptr};
+    json parameters_{};
+    string_t method_{};
+    bool has_method_{false};
+    bool has_parameters_{false};
+    bool more_{false};
+    bool oneway_{false};
+    bool upgrade_{false};
+
+    [[nodiscard]] bool building() const { return not stack_.empty() and depth_ == stack_.size() + 1; }
+
+    // Values of the known members have been handled already, anything else there is invalid
+    [[nodiscard]] bool valid_here() const
+    {
+        return depth_ > 1 or (depth_ == 1 and member_ == member::other);
+    }
+
+    template <typename Value>
+    json* add(Value&& val)
+    {
+        auto& parent = *stack_.back();
+        if (parent.is_array()) {
+            return &parent.get_ref<json::array_t&>().emplace_back(std::forward<Value>(val));
+        }
+        *element_ = json(std::forward<Value>(val));
+        return element_;
+    }
+
+    template <typename Value>
+    bool value(Value&& val)
+    {
+        if (not valid_here()) return false;
+        if (building()) { add(std::forward<Value>(val)); }
+        return true;
+    }
+
+    bool start_container(json::value_t type)
+    {
+        if (not valid_here()) return false;
+        if (building()) { stack_.push_back(add(type)); }
+        ++depth_;
+        return true;
+    }
+
+    bool end_container()
+    {
+        if (building()) { stack_.pop_back(); }
+        --depth_;
+        return true;
+    }
+};
+
+// Parses a received frame as varlink call, std::nullopt if it isn't one
+inline std::optional<basic_varlink_message> parse_call(const char* begin, const char* end)
+{
+    call_parser parser{};
+    if (not json::sax_parse(begin, end, &parser)) { return std::nullopt; }
+    return parser.message();
+}
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_CALL_PARSER_HPP
@@ -0,0 +1,75 @@
+#ifndef LIBVARLINK_COUNTER_HPP
+#define LIBVARLINK_COUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace varlink::detail {
+// Statistics counter that may be read from any thread while its owner updates it.
+// Copying (and thus moving) takes a snapshot, so classes holding counters stay movable.
+class counter {
+  public:
+    counter() noexcept = default;
+    counter(const counter& other) noexcept : value_(other.load()) {}
+    counter& operator=(const counter& other) noexcept
+    {
+        value_.store(other.load(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    counter& operator+=(uint64_t n) noexcept
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+        return *this;
+    }
+    counter& operator++() noexcept { return *this += 1; }
+
+    [[nodiscard]] uint64_t load() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// A setting that may be changed while other threads read it. Copies take a snapshot like
+// counter's do.
+template <typename T>
+class atomic_value {
+  public:
+    explicit atomic_value(T value) noexcept : value_(value) {}
+    atomic_value(const atomic_value& other) noexcept : value_(other.load()) {}
+    atomic_value& operator=(const atomic_value& other) noexcept
+    {
+        store(other.load());
+        return *this;
+    }
+
+    void store(T value) noexcept { value_.store(value, std::memory_order_relaxed); }
+    [[nodiscard]] T load() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<T> value_;
+};
+
+// Asynchronous operations that were started and haven't completed yet. Completing one is
+// the last access to its owner, so an owner that was seen idle may be destroyed.
+class operation_count {
+  public:
+    operation_count() noexcept = default;
+    operation_count(const operation_count& other) noexcept : value_(other.value_.load()) {}
+    operation_count& operator=(const operation_count& other) noexcept
+    {
+        value_.store(other.value_.load());
+        return *this;
+    }
+
+    void started(uint64_t n = 1) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+    void completed(uint64_t n = 1) noexcept { value_.fetch_sub(n, std::memory_order_release); }
+
+    [[nodiscard]] bool idle() const noexcept { return value_.load(std::memory_order_acquire) == 0; }
+
+  private:
+    std::atomic<uint64_t> value_{0};
+};
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_COUNTER_HPP
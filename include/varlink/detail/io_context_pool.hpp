@@ -0,0 +1,81 @@
+#ifndef LIBVARLINK_IO_CONTEXT_POOL_HPP
+#define LIBVARLINK_IO_CONTEXT_POOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <varlink/detail/config.hpp>
+
+namespace varlink::detail {
+// A set of io_contexts, each run by its own threads until stopped. With one thread per
+// io_context, all handlers bound to one of its executors run on that same thread.
+class io_context_pool {
+  public:
+    using executor_type = net::io_context::executor_type;
+
+    io_context_pool(size_t contexts, size_t threads_per_context)
+    {
+        contexts = std::max<size_t>(contexts, 1);
+        threads_per_context = std::max<size_t>(threads_per_context, 1);
+        for (size_t i = 0; i < contexts; i++) {
+            contexts_.push_back(
+                std::make_unique<net::io_context>(static_cast<int>(threads_per_context)));
+            work_.emplace_back(contexts_.back()->get_executor());
+        }
+        for (auto& ctx : contexts_) {
+            for (size_t i = 0; i < threads_per_context; i++) {
+                threads_.emplace_back([&ctx = *ctx]() { ctx.run(); });
+            }
+        }
+    }
+
+    io_context_pool(const io_context_pool&) = delete;
+    io_context_pool& operator=(const io_context_pool&) = delete;
+    io_context_pool(io_context_pool&&) = delete;
+    io_context_pool& operator=(io_context_pool&&) = delete;
+
+    ~io_context_pool()
+    {
+        stop();
+        join();
+    }
+
+    [[nodiscard]] size_t size() const noexcept { return contexts_.size(); }
+
+    executor_type get_executor() { return contexts_.front()->get_executor(); }
+
+    executor_type executor_at(size_t index) { return contexts_.at(index)->get_executor(); }
+
+    // Round-robin over all io_contexts
+    executor_type next_executor()
+    {
+        const auto i = next_.fetch_add(1, std::memory_order_relaxed);
+        return contexts_[i % contexts_.size()]->get_executor();
+    }
+
+    void stop()
+    {
+        for (auto& ctx : contexts_) {
+            ctx->stop();
+        }
+    }
+
+    // Like net::thread_pool::join(), waits for outstanding work unless stopped before
+    void join()
+    {
+        work_.clear();
+        for (auto& thread : threads_) {
+            if (thread.joinable()) { thread.join(); }
+        }
+    }
+
+  private:
+    std::vector<std::unique_ptr<net::io_context>> contexts_{};
+    std::vector<net::executor_work_guard<executor_type>> work_{};
+    std::vector<std::thread> threads_{};
+    std::atomic<size_t> next_{0};
+};
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_IO_CONTEXT_POOL_HPP
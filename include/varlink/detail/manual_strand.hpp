@@ -7,32 +7,92 @@
 #ifndef LIBVARLINK_MANUAL_STRAND_H
 #define LIBVARLINK_MANUAL_STRAND_H
 
-#include <list>
-#include <queue>
+#include <mutex>
+#include <vector>
 #include <asio/strand.hpp>
 #include <varlink/detail/config.hpp>
-#include <varlink/detail/movable_function.hpp>
+#include <varlink/detail/unique_function.hpp>
 
 namespace varlink::detail {
 template <typename Executor>
 class manual_strand {
   public:
-    using function_type = movable_function<void()>;
+    using function_type = unique_function<void()>;
+
+    // FIFO on a circular buffer. It only grows, so pushing doesn't allocate once the
+    // queue has reached its usual size.
     template <typename T>
-    using queue = std::queue<T, std::list<T>>;
+    class queue {
+      public:
+        [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+        [[nodiscard]] size_t size() const noexcept { return size_; }
+
+        void push(T&& value)
+        {
+            if (size_ == slots_.size()) { grow(); }
+            slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(value);
+            ++size_;
+        }
+
+        T pop()
+        {
+            T value = std::move(slots_[head_]);
+            slots_[head_] = T{};
+            head_ = (head_ + 1) & (slots_.size() - 1);
+            --size_;
+            return value;
+        }
+
+      private:
+        void grow()
+        {
+            // Capacity stays a power of two, so indices wrap with a mask
+            std::vector<T> slots(std::max<size_t>(slots_.size() * 2, 8));
+            for (size_t i = 0; i < size_; i++) {
+                slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+            }
+            slots_ = std::move(slots);
+            head_ = 0;
+        }
+
+        std::vector<T> slots_{};
+        size_t head_{0};
+        size_t size_{0};
+    };
 
     explicit manual_strand(const Executor& executor) : strand_{executor} {}
 
+    // Only valid while no function is queued or executing, like moving the owner of the
+    // strand, whose address the functions usually capture.
+    manual_strand(manual_strand&& other) noexcept
+        : strand_(std::move(other.strand_)), queue_(std::move(other.queue_))
+    {
+    }
+    manual_strand& operator=(manual_strand&& other) noexcept
+    {
+        strand_ = std::move(other.strand_);
+        queue_ = std::move(other.queue_);
+        return *this;
+    }
+
+    // Functions pushed while another one is executing are only queued, the strand is
+    // only dispatched to when it was idle.
     void push(function_type function)
     {
-        net::dispatch(strand_, [this, function = std::move(function)]() mutable {
+        {
+            std::lock_guard lock(mutex_);
             queue_.push(std::move(function));
+            if (executing_) { return; }
+            executing_ = true;
+        }
+        net::dispatch(strand_, [this] { execute(); });
+    }
 
-            if (not executing_) {
-                executing_ = true;
-                execute();
-            }
-        });
+    // False while functions are queued or one is executing
+    [[nodiscard]] bool idle()
+    {
+        std::lock_guard lock(mutex_);
+        return not executing_;
     }
 
     void next()
@@ -43,18 +103,21 @@ class manual_strand {
   private:
     void execute()
     {
-        if (queue_.empty()) {
-            executing_ = false;
-            return;
+        function_type function;
+        {
+            std::lock_guard lock(mutex_);
+            if (queue_.empty()) {
+                executing_ = false;
+                return;
+            }
+            function = queue_.pop();
         }
-
-        auto function = std::move(queue_.front());
-        queue_.pop();
         function();
     }
 
     net::strand<Executor> strand_;
-    queue<function_type> queue_;
+    std::mutex mutex_{};
+    queue<function_type> queue_{};
     bool executing_{false};
 };
 } // namespace varlink::detail
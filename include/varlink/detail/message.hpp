@@ -2,6 +2,9 @@
 #define LIBVARLINK_MESSAGE_HPP
 
 #include <varlink/detail/nl_json.hpp>
+#ifdef VARLINK_ENABLE_TRACING
+#include <varlink/detail/trace.hpp>
+#endif
 
 namespace varlink {
 
@@ -16,19 +19,35 @@ class basic_varlink_message {
   private:
     json _json;
     callmode _mode{callmode::basic};
+    // Length of the interface part of the qualified method name, or npos if it has no dot
+    size_t _ifname_length{std::string_view::npos};
+
+    [[nodiscard]] std::string_view qualified_method() const
+    {
+        return _json["method"].get_ref<const std::string&>();
+    }
 
   public:
     basic_varlink_message() = default;
-    explicit basic_varlink_message(const json& msg) : _json(msg)
+    explicit basic_varlink_message(const json& msg) : basic_varlink_message(json(msg)) {}
+
+    explicit basic_varlink_message(json&& msg) : _json(std::move(msg))
     {
+#ifdef VARLINK_ENABLE_TRACING
+        const detail::trace_span span{"message"};
+#endif
         if (!_json.is_object() or !_json.contains("method") or !_json["method"].is_string()
             or (_json.contains("parameters") && !_json["parameters"].is_object())) {
-            throw std::invalid_argument("Not a varlink message: " + msg.dump());
+            throw std::invalid_argument("Not a varlink message: " + _json.dump());
         }
-        _mode = (msg.contains("more") && msg["more"].get<bool>())       ? callmode::more
-              : (msg.contains("oneway") && msg["oneway"].get<bool>())   ? callmode::oneway
-              : (msg.contains("upgrade") && msg["upgrade"].get<bool>()) ? callmode::upgrade
-                                                                        : callmode::basic;
+        const auto flag = [this](const char* name) {
+            return _json.contains(name) && _json[name].get<bool>();
+        };
+        _mode = flag("more")    ? callmode::more
+              : flag("oneway")  ? callmode::oneway
+              : flag("upgrade") ? callmode::upgrade
+                                : callmode::basic;
+        _ifname_length = qualified_method().rfind('.');
     }
 
     basic_varlink_message(const std::string_view method, const json& parameters)
@@ -36,42 +55,63 @@ class basic_varlink_message {
     {
     }
 
+    basic_varlink_message(const std::string_view method, json&& parameters)
+        : basic_varlink_message(method, std::move(parameters), callmode::basic)
+    {
+    }
+
     basic_varlink_message(const std::string_view method, const json& parameters, callmode mode)
-        : _json({{"method", method}}), _mode(mode)
+        : basic_varlink_message(method, json(parameters), mode)
+    {
+    }
+
+    basic_varlink_message(const std::string_view method, json&& parameters, callmode mode)
+        : _json(json::object_t{{"method", method}}), _mode(mode)
     {
+#ifdef VARLINK_ENABLE_TRACING
+        const detail::trace_span span{"message"};
+#endif
         if (not parameters.is_null() and not parameters.is_object()) {
             throw std::invalid_argument("parameters is not an object");
         }
-        else if (not parameters.empty()) {
-            _json["parameters"] = parameters;
-        }
-        if (_mode == callmode::oneway) { _json["oneway"] = true; }
+        auto& message = _json.get_ref<json::object_t&>();
+        if (not parameters.empty()) { message.emplace("parameters", std::move(parameters)); }
+        if (_mode == callmode::oneway) { message.emplace("oneway", true); }
         else if (_mode == callmode::more) {
-            _json["more"] = true;
+            message.emplace("more", true);
         }
         else if (_mode == callmode::upgrade) {
-            _json["upgrade"] = true;
+            message.emplace("upgrade", true);
         }
+        _ifname_length = method.rfind('.');
     }
 
     [[nodiscard]] auto mode() const { return _mode; }
 
-    [[nodiscard]] json parameters() const
+    [[nodiscard]] const json& parameters() const
+    {
+        static const json empty_parameters = json::object();
+        const auto params = _json.find("parameters");
+        return (params != _json.end()) ? *params : empty_parameters;
+    }
+    // Moves the parameters out, the message keeps its method and mode
+    [[nodiscard]] json take_parameters()
     {
-        return _json.contains("parameters") ? _json["parameters"] : json::object();
+        const auto params = _json.find("parameters");
+        return (params != _json.end()) ? std::move(*params) : json::object();
     }
     [[nodiscard]] const json& json_data() const { return _json; }
 
-    [[nodiscard]] std::string interface() const
+    // Both views point into the message, they are valid as long as it is
+    [[nodiscard]] std::string_view interface() const
     {
-        const auto& fqmethod = _json["method"].get<std::string>();
-        return fqmethod.substr(0, fqmethod.rfind('.'));
+        return qualified_method().substr(0, _ifname_length);
     }
 
-    [[nodiscard]] std::string method() const
+    [[nodiscard]] std::string_view method() const
     {
-        const auto& fqmethod = _json["method"].get<std::string>();
-        return fqmethod.substr(fqmethod.rfind('.') + 1);
+        return qualified_method().substr(
+            _ifname_length == std::string_view::npos ? 0 : _ifname_length + 1);
     }
 
     friend bool operator==(const basic_varlink_message& lhs, const basic_varlink_message& rhs) noexcept;
@@ -84,6 +124,11 @@ class typed_varlink_message : public basic_varlink_message {
         : basic_varlink_message(method, parameters, CallMode)
     {
     }
+
+    typed_varlink_message(const std::string_view method, json&& parameters)
+        : basic_varlink_message(method, std::move(parameters), CallMode)
+    {
+    }
 };
 
 using varlink_message = typed_varlink_message<callmode::basic>;
@@ -0,0 +1,283 @@
+#ifndef LIBVARLINK_METRICS_HPP
+#define LIBVARLINK_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <varlink/detail/counter.hpp>
+#include <varlink/detail/varlink_error.hpp>
+
+namespace varlink {
+
+// Latency distribution in log-linear buckets, like an HDR histogram with 3 significant bits:
+// values below 8 ns are exact, above that every power of two is split into 8 buckets, so a
+// bucket is at most 12.5% wide. Values beyond 2^40 ns (18 minutes) land in the last bucket.
+class latency_histogram {
+  public:
+    static constexpr unsigned sub_bucket_bits = 3;
+    static constexpr uint64_t sub_buckets = uint64_t{1} << sub_bucket_bits;
+    static constexpr unsigned max_exponent = 39;
+    static constexpr size_t bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+
+    static constexpr size_t bucket_index(uint64_t ns) noexcept
+    {
+        if (ns < sub_buckets) { return ns; }
+        const auto exponent = static_cast<unsigned>(63 - __builtin_clzll(ns));
+        if (exponent > max_exponent) { return bucket_count - 1; }
+        const auto sub_bucket = (ns >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+        return (exponent - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+    }
+
+    // The largest value that falls into bucket
+    static constexpr uint64_t bucket_upper_bound(size_t bucket) noexcept
+    {
+        if (bucket < sub_buckets) { return bucket; }
+        const auto exponent = bucket / sub_buckets + sub_bucket_bits - 1;
+        const auto sub_bucket = bucket % sub_buckets;
+        return ((sub_buckets + sub_bucket + 1) << (exponent - sub_bucket_bits)) - 1;
+    }
+
+    void record(std::chrono::nanoseconds latency) noexcept
+    {
+        add(bucket_index(static_cast<uint64_t>(std::max(latency.count(), int64_t{0}))), 1);
+    }
+
+    // Adds n values to bucket
+    void add(size_t bucket, uint64_t n) noexcept
+    {
+        buckets_[bucket] += n;
+        count_ += n;
+    }
+
+    void merge(const latency_histogram& other) noexcept
+    {
+        for (size_t i = 0; i < bucket_count; i++) {
+            add(i, other.buckets_[i]);
+        }
+    }
+
+    [[nodiscard]] uint64_t count() const noexcept { return count_; }
+    [[nodiscard]] uint64_t bucket(size_t index) const noexcept { return buckets_[index]; }
+
+    // Upper bound of the bucket holding the value at quantile q (0.0 - 1.0), 0 if empty
+    [[nodiscard]] uint64_t percentile(double q) const noexcept
+    {
+        if (count_ == 0) { return 0; }
+        const auto rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)) + 1;
+        uint64_t seen{0};
+        for (size_t i = 0; i < bucket_count; i++) {
+            seen += buckets_[i];
+            if (seen >= rank) { return bucket_upper_bound(i); }
+        }
+        return bucket_upper_bound(bucket_count - 1);
+    }
+
+  private:
+    std::array<uint64_t, bucket_count> buckets_{};
+    uint64_t count_{0};
+};
+
+struct method_stats {
+    uint64_t calls{0};
+    uint64_t errors{0};
+    // Time from receiving a call to its final reply
+    latency_histogram latency{};
+
+    void merge(const method_stats& other) noexcept
+    {
+        calls += other.calls;
+        errors += other.errors;
+        latency.merge(other.latency);
+    }
+};
+
+// Connections of all servers using a service
+struct transport_stats {
+    uint64_t sessions_active{0};
+    uint64_t sessions_total{0};
+    uint64_t bytes_received{0};
+    uint64_t bytes_sent{0};
+    // Calls received that have no final reply yet
+    uint64_t calls_in_flight{0};
+    // Replies handed to a connection that weren't written to the socket yet
+    uint64_t queued_replies{0};
+
+    void merge(const transport_stats& other) noexcept
+    {
+        sessions_active += other.sessions_active;
+        sessions_total += other.sessions_total;
+        bytes_received += other.bytes_received;
+        bytes_sent += other.bytes_sent;
+        calls_in_flight += other.calls_in_flight;
+        queued_replies += other.queued_replies;
+    }
+};
+
+// Point in time view of a varlink_service's metrics. Snapshots of several services (or of
+// the same service at different times, for rates) can be merged.
+struct metrics_snapshot {
+    transport_stats transport{};
+    // By qualified method name
+    std::map<std::string, method_stats, std::less<>> methods{};
+    // Error replies by error name, including those for unknown methods
+    std::map<std::string, uint64_t, std::less<>> errors{};
+
+    void merge(const metrics_snapshot& other)
+    {
+        transport.merge(other.transport);
+        for (const auto& [name, stats] : other.methods) {
+            methods[name].merge(stats);
+        }
+        for (const auto& [name, count] : other.errors) {
+            errors[name] += count;
+        }
+    }
+};
+
+namespace detail {
+using metrics_clock = std::chrono::steady_clock;
+
+// Counters are split into shards, each thread updates the one it got assigned on first
+// use. Threads only share a shard (and its cache lines) if there are more of them.
+inline constexpr size_t metrics_shards = 8;
+
+inline size_t metrics_shard() noexcept
+{
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed)
+                                    % metrics_shards;
+    return shard;
+}
+
+// Calls, errors and latencies of a single method
+class method_metrics {
+  public:
+    void record_call() noexcept { ++shards_[metrics_shard()].calls; }
+
+    // Final reply of a call received at started, an error reply if error
+    void record_reply(metrics_clock::time_point started, bool error) noexcept
+    {
+        const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            metrics_clock::now() - started);
+        const auto ns = static_cast<uint64_t>(std::max(latency.count(), int64_t{0}));
+        auto& shard = shards_[metrics_shard()];
+        if (error) { ++shard.errors; }
+        ++shard.latency[latency_histogram::bucket_index(ns)];
+    }
+
+    [[nodiscard]] method_stats snapshot() const noexcept
+    {
+        method_stats stats{};
+        for (const auto& shard : shards_) {
+            stats.calls += shard.calls.load();
+            stats.errors += shard.errors.load();
+            for (size_t i = 0; i < latency_histogram::bucket_count; i++) {
+                stats.latency.add(i, shard.latency[i].load());
+            }
+        }
+        return stats;
+    }
+
+  private:
+    struct alignas(64) shard_type {
+        counter calls{};
+        counter errors{};
+        std::array<counter, latency_histogram::bucket_count> latency{};
+    };
+    std::array<shard_type, metrics_shards> shards_{};
+};
+
+// Updated by the sessions and connections of a service. Gauges are kept as two counters
+// that only grow, so shards can be summed up without a lock.
+class transport_metrics {
+  public:
+    void session_opened() noexcept { ++shards_[metrics_shard()].sessions_opened; }
+    void session_closed() noexcept { ++shards_[metrics_shard()].sessions_closed; }
+    void received(size_t bytes) noexcept { shards_[metrics_shard()].bytes_received += bytes; }
+    void sent(size_t bytes) noexcept { shards_[metrics_shard()].bytes_sent += bytes; }
+    void replies_queued(size_t n) noexcept { shards_[metrics_shard()].replies_queued += n; }
+    void replies_written(size_t n) noexcept { shards_[metrics_shard()].replies_written += n; }
+
+    // Without calls_in_flight, which comes from the method metrics
+    [[nodiscard]] transport_stats snapshot() const noexcept
+    {
+        uint64_t closed{0};
+        uint64_t written{0};
+        transport_stats stats{};
+        for (const auto& shard : shards_) {
+            stats.sessions_total += shard.sessions_opened.load();
+            closed += shard.sessions_closed.load();
+            stats.bytes_received += shard.bytes_received.load();
+            stats.bytes_sent += shard.bytes_sent.load();
+            stats.queued_replies += shard.replies_queued.load();
+            written += shard.replies_written.load();
+        }
+        // Shards are read one after the other, a gauge may be caught between its updates
+        stats.sessions_active = stats.sessions_total - std::min(closed, stats.sessions_total);
+        stats.queued_replies -= std::min(written, stats.queued_replies);
+        return stats;
+    }
+
+  private:
+    struct alignas(64) shard_type {
+        counter sessions_opened{};
+        counter sessions_closed{};
+        counter bytes_received{};
+        counter bytes_sent{};
+        counter replies_queued{};
+        counter replies_written{};
+    };
+    std::array<shard_type, metrics_shards> shards_{};
+};
+
+// Error replies by name. The names are interned by varlink_category(), the built-in errors
+// are counted without a lock.
+class error_metrics {
+  public:
+    void record(std::string_view error)
+    {
+        const auto code = make_varlink_error(error).value();
+        auto& shard = shards_[metrics_shard()];
+        if (static_cast<size_t>(code) < builtin_count) {
+            ++shard.builtin[static_cast<size_t>(code)];
+        }
+        else {
+            std::lock_guard lock(shard.mutex);
+            shard.other[code] += 1;
+        }
+    }
+
+    void snapshot(std::map<std::string, uint64_t, std::less<>>& errors) const
+    {
+        const auto& category = varlink_category();
+        for (auto& shard : shards_) {
+            for (size_t i = 0; i < builtin_count; i++) {
+                if (const auto n = shard.builtin[i].load(); n > 0) {
+                    errors[category.message(static_cast<int>(i))] += n;
+                }
+            }
+            std::lock_guard lock(shard.mutex);
+            for (const auto& [code, n] : shard.other) {
+                errors[category.message(code)] += n;
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t builtin_count = varlink_error_category::builtin_errors.size();
+
+    struct alignas(64) shard_type {
+        std::array<counter, builtin_count> builtin{};
+        mutable std::mutex mutex{};
+        std::unordered_map<int, uint64_t> other{};
+    };
+    std::array<shard_type, metrics_shards> shards_{};
+};
+} // namespace detail
+} // namespace varlink
+
+#endif // LIBVARLINK_METRICS_HPP
@@ -0,0 +1,81 @@
+#ifndef LIBVARLINK_PROBES_HPP
+#define LIBVARLINK_PROBES_HPP
+
+// Static tracepoints of the varlink provider, for bpftrace, perf and systemtap. With
+// VARLINK_ENABLE_USDT the probes are emitted by source/probes.cpp of the library, the only
+// translation unit that includes sys/sdt.h. Code that includes this header may use sys/sdt.h
+// for probes of its own, with or without semaphores. A probe site loads the probe's
+// semaphore, which the tracer increments on attach, and evaluates the arguments and calls
+// into the library only while a tracer is attached. Without VARLINK_ENABLE_USDT the probes
+// and their arguments compile to nothing.
+//
+// session_accept(void* session)
+// session_close(void* session)
+// frame_receive(void* connection, size_t bytes)       a frame (without \0) was read
+// frame_send(void* connection, size_t bytes)          a frame was serialized and queued
+// write_done(void* connection, size_t bytes, size_t frames)
+// call_start(const char* method)
+// call_done(const char* method, int64_t duration_ns, const char* error)
+//                                                     final reply, error is "" on success,
+//                                                     the send error's what() if the call
+//                                                     ended without a reply. duration_ns is
+//                                                     -1 for calls that started before the
+//                                                     tracer attached
+#ifdef VARLINK_ENABLE_USDT
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Defined by source/probes.cpp, sys/sdt.h refers to them as <provider>_<probe>_semaphore
+extern "C" {
+extern volatile unsigned short varlink_session_accept_semaphore;
+extern volatile unsigned short varlink_session_close_semaphore;
+extern volatile unsigned short varlink_frame_receive_semaphore;
+extern volatile unsigned short varlink_frame_send_semaphore;
+extern volatile unsigned short varlink_write_done_semaphore;
+extern volatile unsigned short varlink_call_start_semaphore;
+extern volatile unsigned short varlink_call_done_semaphore;
+}
+
+#define VARLINK_PROBE_ENABLED(name) __builtin_expect(varlink_##name##_semaphore != 0, 0)
+#define VARLINK_PROBE1(name, a1) \
+    (VARLINK_PROBE_ENABLED(name) ? ::varlink::detail::probe_##name(a1) : static_cast<void>(0))
+#define VARLINK_PROBE2(name, a1, a2)                                       \
+    (VARLINK_PROBE_ENABLED(name) ? ::varlink::detail::probe_##name(a1, a2) \
+                                 : static_cast<void>(0))
+#define VARLINK_PROBE3(name, a1, a2, a3)                                       \
+    (VARLINK_PROBE_ENABLED(name) ? ::varlink::detail::probe_##name(a1, a2, a3) \
+                                 : static_cast<void>(0))
+
+namespace varlink::detail {
+void probe_session_accept(const void* session) noexcept;
+void probe_session_close(const void* session) noexcept;
+void probe_frame_receive(const void* connection, size_t bytes) noexcept;
+void probe_frame_send(const void* connection, size_t bytes) noexcept;
+void probe_write_done(const void* connection, size_t bytes, size_t frames) noexcept;
+void probe_call_start(const char* method) noexcept;
+void probe_call_done(const char* method, int64_t duration_ns, const char* error) noexcept;
+
+// Start of a call for call_done, the clock is only read while a tracer is attached
+inline std::chrono::steady_clock::time_point probe_start() noexcept
+{
+    return VARLINK_PROBE_ENABLED(call_done) ? std::chrono::steady_clock::now()
+                                            : std::chrono::steady_clock::time_point{};
+}
+
+inline int64_t elapsed_ns(std::chrono::steady_clock::time_point started) noexcept
+{
+    if (started == std::chrono::steady_clock::time_point{}) { return -1; }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - started)
+        .count();
+}
+} // namespace varlink::detail
+#else
+#define VARLINK_PROBE_ENABLED(name) false
+#define VARLINK_PROBE1(name, a1) static_cast<void>(0)
+#define VARLINK_PROBE2(name, a1, a2) static_cast<void>(0)
+#define VARLINK_PROBE3(name, a1, a2, a3) static_cast<void>(0)
+#endif
+
+#endif // LIBVARLINK_PROBES_HPP
@@ -0,0 +1,265 @@
+#ifndef LIBVARLINK_TRACE_HPP
+#define LIBVARLINK_TRACE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include <varlink/detail/nl_json.hpp>
+
+namespace varlink {
+namespace detail {
+inline int64_t trace_now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// A stage of a traced call, name is a string literal
+struct trace_event {
+    const char* name;
+    uint64_t call;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+// The events of one thread. Only that thread writes, once the ring is full it overwrites the
+// oldest events. Readers check a slot's sequence number before and after copying it and skip
+// the slot if it was overwritten meanwhile, so neither side ever waits for the other.
+class trace_ring {
+  public:
+    static constexpr uint64_t capacity = 4096;
+
+    void push(const trace_event& event) noexcept
+    {
+        const auto index = written_.load(std::memory_order_relaxed);
+        auto& slot = slots_[index % capacity];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.call.store(event.call, std::memory_order_relaxed);
+        slot.begin_ns.store(event.begin_ns, std::memory_order_relaxed);
+        slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        written_.store(index + 1, std::memory_order_release);
+    }
+
+    // Appends the events still in the ring, oldest first
+    void read(std::vector<trace_event>& events) const
+    {
+        const auto written = written_.load(std::memory_order_acquire);
+        for (auto index = written - std::min(written, capacity); index < written; index++) {
+            const auto& slot = slots_[index % capacity];
+            const auto sequence = 2 * index + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != sequence) continue;
+            const trace_event event{
+                slot.name.load(std::memory_order_relaxed),
+                slot.call.load(std::memory_order_relaxed),
+                slot.begin_ns.load(std::memory_order_relaxed),
+                slot.end_ns.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+                events.push_back(event);
+            }
+        }
+    }
+
+  private:
+    struct slot_type {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> call{0};
+        std::atomic<int64_t> begin_ns{0};
+        std::atomic<int64_t> end_ns{0};
+    };
+    std::array<slot_type, capacity> slots_{};
+    std::atomic<uint64_t> written_{0};
+};
+
+class tracer {
+  public:
+    static tracer& instance()
+    {
+        static tracer global{};
+        return global;
+    }
+
+    // 0 while tracing is stopped
+    std::atomic<uint32_t> sample_every{0};
+    std::atomic<uint64_t> next_call{1};
+    // Events before the current trace was started aren't exported
+    std::atomic<int64_t> started_ns{0};
+
+    // A finished thread hands its ring back and the next new thread reuses it, so there are
+    // only as many rings as threads ran at once. The events of finished threads can still be
+    // exported until they are overwritten.
+    trace_ring& local_ring()
+    {
+        thread_local const ring_lease lease{*this};
+        return *lease.ring;
+    }
+
+    // Threads running at the same time have distinct rings
+    [[nodiscard]] std::vector<std::shared_ptr<const trace_ring>> rings() const
+    {
+        std::lock_guard lock(mutex_);
+        return {rings_.begin(), rings_.end()};
+    }
+
+  private:
+    struct ring_lease {
+        tracer& owner;
+        std::shared_ptr<trace_ring> ring;
+
+        explicit ring_lease(tracer& t) : owner(t), ring(t.acquire_ring()) {}
+        ~ring_lease() { owner.release_ring(ring); }
+
+        ring_lease(const ring_lease&) = delete;
+        ring_lease& operator=(const ring_lease&) = delete;
+        ring_lease(ring_lease&&) = delete;
+        ring_lease& operator=(ring_lease&&) = delete;
+    };
+
+    mutable std::mutex mutex_{};
+    std::vector<std::shared_ptr<trace_ring>> rings_{};
+    std::vector<std::shared_ptr<trace_ring>> free_rings_{};
+
+    std::shared_ptr<trace_ring> acquire_ring()
+    {
+        std::lock_guard lock(mutex_);
+        if (free_rings_.empty()) { return rings_.emplace_back(std::make_shared<trace_ring>()); }
+        auto ring = std::move(free_rings_.back());
+        free_rings_.pop_back();
+        return ring;
+    }
+
+    void release_ring(std::shared_ptr<trace_ring> ring)
+    {
+        std::lock_guard lock(mutex_);
+        free_rings_.push_back(std::move(ring));
+    }
+};
+
+// Id of the call this thread is working on, 0 if it isn't traced
+inline uint64_t& trace_current_call() noexcept
+{
+    thread_local uint64_t call{0};
+    return call;
+}
+
+// Decides whether to trace a call that was just received, returns its id or 0
+inline uint64_t trace_sample() noexcept
+{
+    auto& global = tracer::instance();
+    const auto sample_every = global.sample_every.load(std::memory_order_relaxed);
+    if (sample_every == 0) { return 0; }
+    thread_local uint32_t received{0};
+    if (++received < sample_every) { return 0; }
+    received = 0;
+    return global.next_call.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Makes call the current call of this thread until the scope ends
+class trace_scope {
+  public:
+    explicit trace_scope(uint64_t call) noexcept
+        : previous_(std::exchange(trace_current_call(), call))
+    {
+    }
+    ~trace_scope() { trace_current_call() = previous_; }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+    trace_scope(trace_scope&&) = delete;
+    trace_scope& operator=(trace_scope&&) = delete;
+
+  private:
+    uint64_t previous_;
+};
+
+// Start of a stage of the current call, for stages that end on another thread or later on
+struct trace_mark {
+    uint64_t call{trace_current_call()};
+    int64_t begin_ns{call == 0 ? 0 : trace_now()};
+
+    void record(const char* name) const noexcept
+    {
+        if (call != 0) {
+            tracer::instance().local_ring().push({name, call, begin_ns, trace_now()});
+        }
+    }
+};
+
+// Records the time until the end of the scope as stage name of call
+class trace_span {
+  public:
+    explicit trace_span(const char* name, uint64_t call = trace_current_call()) noexcept
+        : name_(name), mark_{call}
+    {
+    }
+    ~trace_span() { mark_.record(name_); }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+    trace_span(trace_span&&) = delete;
+    trace_span& operator=(trace_span&&) = delete;
+
+  private:
+    const char* name_;
+    trace_mark mark_;
+};
+} // namespace detail
+
+// Traces one in every sample_every calls that servers receive from now on. Events of earlier
+// traces are left out of the export.
+inline void start_tracing(uint32_t sample_every = 1) noexcept
+{
+    auto& global = detail::tracer::instance();
+    global.started_ns.store(detail::trace_now(), std::memory_order_relaxed);
+    global.sample_every.store(std::max(sample_every, uint32_t{1}), std::memory_order_relaxed);
+}
+
+// Stages of calls already traced are still recorded until the calls are done
+inline void stop_tracing() noexcept
+{
+    detail::tracer::instance().sample_every.store(0, std::memory_order_relaxed);
+}
+
+// Writes the events of the current trace as Chrome trace JSON, which ui.perfetto.dev and
+// chrome://tracing open. Every stage is a complete event on the thread that ran it, with
+// the id of its call as argument. Each ring keeps its last trace_ring::capacity events, a
+// ring is passed on to a new thread once its thread finished.
+inline void write_chrome_trace(std::ostream& out)
+{
+    const auto& global = detail::tracer::instance();
+    const auto started_ns = global.started_ns.load(std::memory_order_relaxed);
+    const auto rings = global.rings();
+    json::array_t trace_events{};
+    std::vector<detail::trace_event> events{};
+    for (size_t ring = 0; ring < rings.size(); ring++) {
+        events.clear();
+        rings[ring]->read(events);
+        for (const auto& event : events) {
+            if (event.begin_ns < started_ns) continue;
+            trace_events.push_back(
+                {{"name", event.name},
+                 {"cat", "varlink"},
+                 {"ph", "X"},
+                 {"ts", static_cast<double>(event.begin_ns - started_ns) / 1000.0},
+                 {"dur", static_cast<double>(event.end_ns - event.begin_ns) / 1000.0},
+                 {"pid", 1},
+                 {"tid", ring},
+                 {"args", {{"call", event.call}}}});
+        }
+    }
+    out << json{{"traceEvents", std::move(trace_events)}, {"displayTimeUnit", "ns"}};
+}
+} // namespace varlink
+
+#endif // LIBVARLINK_TRACE_HPP
@@ -0,0 +1,149 @@
+#ifndef LIBVARLINK_UNIQUE_FUNCTION_HPP
+#define LIBVARLINK_UNIQUE_FUNCTION_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace varlink::detail {
+// Enough for the handlers json_connection, async_client and manual_strand store: the
+// largest is a queued call, holding the client, the message and the user's completion
+// handler with a few captures of its own.
+inline constexpr size_t default_function_storage = 96;
+
+template <typename Signature, size_t InlineSize = default_function_storage>
+class unique_function;
+
+// Move-only replacement for std::function. Callables up to InlineSize bytes that can be
+// moved without throwing are stored inline, larger ones on the heap.
+template <typename R, typename... Args, size_t InlineSize>
+class unique_function<R(Args...), InlineSize> {
+  public:
+    static constexpr size_t inline_size = InlineSize;
+
+    template <typename Fn>
+    static constexpr bool stored_inline = sizeof(Fn) <= InlineSize
+                                          and alignof(Fn) <= alignof(std::max_align_t)
+                                          and std::is_nothrow_move_constructible_v<Fn>;
+
+    unique_function() noexcept = default;
+    unique_function(std::nullptr_t) noexcept {}
+
+    template <
+        typename Fn,
+        typename = std::enable_if_t<
+            not std::is_same_v<std::decay_t<Fn>, unique_function>
+            and std::is_invocable_r_v<R, std::decay_t<Fn>&, Args...>>>
+    unique_function(Fn&& fn)
+    {
+        using F = std::decay_t<Fn>;
+        if constexpr (stored_inline<F>) {
+            ::new (static_cast<void*>(&storage_)) F(std::forward<Fn>(fn));
+        }
+        else {
+            ::new (static_cast<void*>(&storage_)) F*(new F(std::forward<Fn>(fn)));
+        }
+        vtable_ = &vtable_for<F>;
+    }
+
+    unique_function(unique_function&& other) noexcept { move_from(other); }
+
+    unique_function& operator=(unique_function&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    unique_function& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template <
+        typename Fn,
+        typename = std::enable_if_t<not std::is_same_v<std::decay_t<Fn>, unique_function>>>
+    unique_function& operator=(Fn&& fn)
+    {
+        return *this = unique_function(std::forward<Fn>(fn));
+    }
+
+    unique_function(const unique_function&) = delete;
+    unique_function& operator=(const unique_function&) = delete;
+
+    ~unique_function() { reset(); }
+
+    explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+    R operator()(Args... args)
+    {
+        if (not vtable_) { throw std::bad_function_call(); }
+        return vtable_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+  private:
+    using storage_type = std::aligned_storage_t<InlineSize, alignof(std::max_align_t)>;
+
+    struct vtable {
+        R (*invoke)(void*, Args&&...);
+        // Move-constructs into dst and destroys src
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <typename F>
+    static F& target(void* storage) noexcept
+    {
+        if constexpr (stored_inline<F>) { return *std::launder(static_cast<F*>(storage)); }
+        else {
+            return **std::launder(static_cast<F**>(storage));
+        }
+    }
+
+    template <typename F>
+    static constexpr vtable vtable_for{
+        [](void* s, Args&&... args) -> R {
+            return static_cast<R>(std::invoke(target<F>(s), std::forward<Args>(args)...));
+        },
+        [](void* dst, void* src) noexcept {
+            if constexpr (stored_inline<F>) {
+                auto& f = target<F>(src);
+                ::new (dst) F(std::move(f));
+                f.~F();
+            }
+            else {
+                ::new (dst) F*(*std::launder(static_cast<F**>(src)));
+            }
+        },
+        [](void* s) noexcept {
+            if constexpr (stored_inline<F>) { target<F>(s).~F(); }
+            else {
+                delete &target<F>(s);
+            }
+        }};
+
+    void move_from(unique_function& other) noexcept
+    {
+        if (other.vtable_) {
+            other.vtable_->relocate(&storage_, &other.storage_);
+            vtable_ = std::exchange(other.vtable_, nullptr);
+        }
+    }
+
+    void reset() noexcept
+    {
+        if (vtable_) { std::exchange(vtable_, nullptr)->destroy(&storage_); }
+    }
+
+    storage_type storage_;
+    const vtable* vtable_{nullptr};
+};
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_UNIQUE_FUNCTION_HPP
@@ -0,0 +1,71 @@
+#ifndef LIBVARLINK_VALIDATOR_HPP
+#define LIBVARLINK_VALIDATOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <varlink/detail/member.hpp>
+#include <varlink/detail/nl_json.hpp>
+
+namespace varlink {
+class varlink_interface;
+}
+
+namespace varlink::detail {
+// A type_spec lowered into a flat array of nodes. Named types are resolved and field names
+// are copied into the program once, so validating data neither searches the interface nor
+// allocates (except for the exception thrown on invalid data). The program is
+// self-contained and stays valid if the interface it was compiled from goes away.
+class type_validator {
+  public:
+    type_validator(
+        const varlink_interface& interface,
+        const type_spec& spec,
+        bool collection = false);
+
+    // Throws invalid_parameter like varlink_interface::validate
+    void validate(const json& data, std::string_view name = "<root>") const;
+    void validate(const json::object_t& data, std::string_view name = "<root>") const;
+
+  private:
+    static constexpr uint32_t no_node = UINT32_MAX;
+
+    enum class op : uint8_t { invalid, enumeration, type_name, structure };
+    enum class primitive : uint8_t { none, string, integer, number, boolean, object };
+
+    struct node {
+        op kind{op::invalid};
+        primitive prim{primitive::none};
+        bool dict{false};
+        bool array{false};
+        bool check_type{false}; // collection, or neither array nor dict
+        uint32_t element{no_node}; // dict and array elements
+        uint32_t target{no_node}; // resolved named type
+        uint32_t first{0}; // into fields or enum_values
+        uint32_t count{0};
+    };
+
+    struct field {
+        std::string key;
+        bool maybe;
+        uint32_t node;
+    };
+
+    std::vector<node> nodes{};
+    std::vector<field> fields{};
+    std::vector<std::string> enum_values{};
+
+    using compile_key = std::pair<const type_spec*, bool>;
+    uint32_t compile(
+        const varlink_interface& interface,
+        const type_spec& spec,
+        bool collection,
+        std::map<compile_key, uint32_t>& compiled);
+
+    void validate(const json& data, uint32_t index, std::string_view name) const;
+    template <typename Object>
+    void validate_fields(const Object& data, const node& n) const;
+};
+} // namespace varlink::detail
+
+#endif // LIBVARLINK_VALIDATOR_HPP
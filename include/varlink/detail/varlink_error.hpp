@@ -1,35 +1,80 @@
 #ifndef LIBVARLINK_VARLINK_ERROR_HPP
 #define LIBVARLINK_VARLINK_ERROR_HPP
 
+#include <array>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <system_error>
+#include <unordered_map>
 #include <varlink/detail/nl_json.hpp>
 
 namespace varlink {
 
+// Maps varlink error names to stable error_code values. The errors of org.varlink.service
+// are registered up front and resolved without taking a lock. Other names are interned on
+// first use and keep their value for the lifetime of the category. Thread-safe.
 class varlink_error_category : public std::error_category {
+  public:
+    static constexpr std::string_view service_error_prefix = "org.varlink.service.";
+    static constexpr std::array<std::string_view, 8> builtin_errors{
+        "no_error",
+        "org.varlink.service.InterfaceNotFound",
+        "org.varlink.service.MethodNotFound",
+        "org.varlink.service.MethodNotImplemented",
+        "org.varlink.service.InvalidParameter",
+        "org.varlink.service.PermissionDenied",
+        "org.varlink.service.ExpectedMore",
+        "org.varlink.service.InternalError",
+    };
+
   private:
-    std::vector<std::string> errors{"no_error"};
+    mutable std::shared_mutex mutex{};
+    // Strings in a deque don't move when it grows, so the map keys stay valid
+    std::deque<std::string> errors{};
+    std::unordered_map<std::string_view, int> index{};
 
   public:
     [[nodiscard]] const char* name() const noexcept final { return "VarlinkError"; }
 
     [[nodiscard]] std::string message(int c) const final
     {
-        try {
-            return errors.at(static_cast<size_t>(c));
-        }
-        catch (std::out_of_range&) {
-            return "unknown";
+        if (c < 0) { return "unknown"; }
+        const auto idx = static_cast<size_t>(c);
+        if (idx < builtin_errors.size()) { return std::string(builtin_errors[idx]); }
+        std::shared_lock lock(mutex);
+        if (idx - builtin_errors.size() < errors.size()) {
+            return errors[idx - builtin_errors.size()];
         }
+        return "unknown";
     }
 
     [[nodiscard]] std::error_code get_error_code(std::string_view error)
     {
-        auto err = std::find(errors.begin(), errors.end(), error);
-        auto idx = err - errors.begin();
-        if (err == errors.end()) errors.emplace_back(error);
-        return {static_cast<int>(idx), *this};
+        if (const auto idx = find_builtin(error); idx >= 0) { return {idx, *this}; }
+        {
+            std::shared_lock lock(mutex);
+            if (auto it = index.find(error); it != index.end()) { return {it->second, *this}; }
+        }
+        std::unique_lock lock(mutex);
+        // Another thread may have interned it while no lock was held
+        if (auto it = index.find(error); it != index.end()) { return {it->second, *this}; }
+        const auto idx = static_cast<int>(builtin_errors.size() + errors.size());
+        index.emplace(errors.emplace_back(error), idx);
+        return {idx, *this};
+    }
+
+  private:
+    static int find_builtin(std::string_view error) noexcept
+    {
+        if (error.substr(0, service_error_prefix.size()) != service_error_prefix) {
+            return error == builtin_errors[0] ? 0 : -1;
+        }
+        for (size_t i = 1; i < builtin_errors.size(); i++) {
+            if (builtin_errors[i] == error) { return static_cast<int>(i); }
+        }
+        return -1;
     }
 };
 
@@ -15,6 +15,16 @@ class varlink_interface {
   public:
     explicit varlink_interface(std::string_view description);
 
+    // An interface parsed at build time by varlink-codegen, which emits the member table.
+    // The strings must outlive the interface unless VARLINK_USE_STRINGS is set.
+    varlink_interface(
+        std::string_view name,
+        std::string_view documentation_,
+        std::vector<detail::member> members_)
+        : ifname(name), documentation(documentation_), members(std::move(members_))
+    {
+    }
+
     [[nodiscard]] std::string_view name() const noexcept { return ifname; }
     [[nodiscard]] std::string_view doc() const noexcept { return documentation; }
 
@@ -44,6 +54,23 @@ class varlink_interface {
         return has_member(name, detail::MemberKind::Error);
     }
 
+    template <typename Function>
+    void for_each_member(Function&& fn) const
+    {
+        for (const auto& m : members) {
+            fn(m);
+        }
+    }
+
+    template <typename Function>
+    void for_each_method(Function&& fn) const
+    {
+        for (const auto& m : members) {
+            if (m.kind == detail::MemberKind::Method) { fn(m); }
+        }
+    }
+
+    // Compiles typespec on every call, see detail::type_validator for repeated validation
     void validate(
         const json& data,
         const detail::type_spec& typespec,
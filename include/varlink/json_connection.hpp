@@ -3,8 +3,18 @@
 #define LIBVARLINK_VARLINK_TRANSPORT_HPP
 
 #include <optional>
+#include <varlink/detail/buffer_pool.hpp>
+#include <varlink/detail/call_parser.hpp>
 #include <varlink/detail/config.hpp>
-#include <varlink/detail/manual_strand.hpp>
+#include <varlink/detail/counter.hpp>
+#ifdef VARLINK_ENABLE_METRICS
+#include <varlink/detail/metrics.hpp>
+#endif
+#include <varlink/detail/probes.hpp>
+#ifdef VARLINK_ENABLE_TRACING
+#include <varlink/detail/trace.hpp>
+#endif
+#include <varlink/detail/unique_function.hpp>
 #include <varlink/detail/nl_json.hpp>
 
 namespace varlink {
@@ -22,22 +32,112 @@ class json_connection {
 
     executor_type get_executor() { return stream.get_executor(); }
 
+    // The read buffer starts at initial_buffer_size and grows geometrically for larger
+    // messages. A message that doesn't fit into max_message_size bytes (excluding the
+    // terminating \0) fails with net::error::message_size.
+    static constexpr size_t initial_buffer_size = BUFSIZ;
+    static constexpr size_t default_max_message_size = 16 * 1024 * 1024;
+
+    [[nodiscard]] size_t max_message_size() const noexcept { return max_message_size_; }
+    void set_max_message_size(size_t size) noexcept { max_message_size_ = size; }
+
+    // Messages queued by async_send while a write is in progress are sent together
+    // with a single gathered write. frames / writes is the average batch size.
+    struct write_statistics {
+        uint64_t writes;
+        uint64_t frames;
+    };
+
+    [[nodiscard]] write_statistics write_stats() const noexcept
+    {
+        return {writes_.load(), frames_.load()};
+    }
+
+    // True until the writes of all messages queued by async_send completed. They refer to
+    // the connection, so it must not be destroyed or replaced before.
+    [[nodiscard]] bool sending() const noexcept { return not pending_sends_.idle(); }
+
+#ifdef VARLINK_ENABLE_METRICS
+    // Counts the bytes and queued replies of this connection into metrics, which must
+    // outlive it. Set by server_session to the counters of its service.
+    void set_metrics(detail::transport_metrics* metrics) noexcept { metrics_ = metrics; }
+#endif
+
   private:
     using byte_buffer = std::vector<char>;
     byte_buffer readbuf;
-    byte_buffer::iterator read_end;
+    size_t max_message_size_{default_max_message_size};
+    // Unparsed data lives in [read_pos, read_end). Consumed messages only advance read_pos,
+    // the remainder is moved to the front once the free space at the end runs low.
+    size_t read_pos{0};
+    size_t read_end{0};
     socket_type stream;
-    detail::manual_strand<executor_type> write_strand;
+
+    // Frames are small and a reply that is written while the previous one is unacknowledged
+    // would otherwise wait for the peer's delayed ACK
+    void disable_nagle()
+    {
+        if constexpr (std::is_same_v<protocol_type, net::ip::tcp>) {
+            if (stream.is_open()) { stream.set_option(net::ip::tcp::no_delay(true)); }
+        }
+    }
+    void disable_nagle([[maybe_unused]] std::error_code& ec)
+    {
+        if constexpr (std::is_same_v<protocol_type, net::ip::tcp>) {
+            stream.set_option(net::ip::tcp::no_delay(true), ec);
+        }
+    }
+
+    struct pending_write {
+        std::string data;
+        detail::unique_function<void(std::error_code)> handler;
+#ifdef VARLINK_ENABLE_TRACING
+        // Serialized, waiting for the write to complete
+        detail::trace_mark queued{};
+#endif
+    };
+    // Only accessed on write_strand
+    net::strand<executor_type> write_strand;
+    std::vector<pending_write> write_queue{};
+    std::vector<pending_write> write_spare{};
+    std::vector<net::const_buffer> write_buffers{};
+    bool writing{false};
+    detail::counter writes_{};
+    detail::counter frames_{};
+    detail::operation_count pending_sends_{};
+#ifdef VARLINK_ENABLE_METRICS
+    detail::transport_metrics* metrics_{nullptr};
+#endif
+#ifdef VARLINK_ENABLE_TRACING
+    // Trace id of the call read_next_message returned last, 0 if it isn't traced
+    uint64_t received_call_{0};
+#endif
+
+    void on_received(size_t n) noexcept
+    {
+        read_end += n;
+#ifdef VARLINK_ENABLE_METRICS
+        if (metrics_ != nullptr) { metrics_->received(n); }
+#endif
+    }
+
+    void on_sent([[maybe_unused]] size_t bytes, [[maybe_unused]] size_t replies) noexcept
+    {
+#ifdef VARLINK_ENABLE_METRICS
+        if (metrics_ != nullptr) {
+            metrics_->sent(bytes);
+            metrics_->replies_written(replies);
+        }
+#endif
+    }
 
   public:
     explicit json_connection(asio::io_context& ctx) : json_connection(socket_type(ctx)) {}
 
     explicit json_connection(socket_type socket)
-        : readbuf(BUFSIZ),
-          read_end(readbuf.begin()),
-          stream(std::move(socket)),
-          write_strand(stream.get_executor())
+        : readbuf(initial_buffer_size), stream(std::move(socket)), write_strand(stream.get_executor())
     {
+        disable_nagle();
     }
 
     json_connection(const json_connection&) = delete;
@@ -47,15 +147,21 @@ class json_connection {
     json_connection& operator=(json_connection&&) = default;
 
     template <typename ConnectHandler>
-    decltype(auto) async_connect(const endpoint_type& endpoint, ConnectHandler&& handler)
+    auto async_connect(const endpoint_type& endpoint, ConnectHandler&& handler)
     {
-        return stream.async_connect(endpoint, std::forward<ConnectHandler>(handler));
+        return net::async_initiate<ConnectHandler, void(std::error_code)>(
+            initiate_async_connect(this), handler, endpoint);
     }
 
-    void connect(const endpoint_type& endpoint) { stream.connect(endpoint); }
+    void connect(const endpoint_type& endpoint)
+    {
+        stream.connect(endpoint);
+        disable_nagle();
+    }
     void connect(const endpoint_type& endpoint, std::error_code& ec)
     {
         stream.connect(endpoint, ec);
+        if (not ec) { disable_nagle(); }
     }
 
     void close() { stream.close(); }
@@ -66,6 +172,7 @@ class json_connection {
 
     bool is_open() { return stream.is_open(); }
 
+    // The message is serialized right away, it doesn't need to outlive this call
     template <typename CompletionHandler>
     auto async_send(const json& message, CompletionHandler&& handler)
     {
@@ -73,57 +180,190 @@ class json_connection {
             initiate_async_send(this), handler, message);
     }
 
+    // Sends a frame that was serialized before, without its terminating \0. The frame is
+    // copied right away, it doesn't need to outlive this call.
+    template <typename CompletionHandler>
+    auto async_send_frame(std::string_view frame, CompletionHandler&& handler)
+    {
+        return net::async_initiate<CompletionHandler, void(std::error_code)>(
+            initiate_async_send(this), handler, frame);
+    }
+
     template <typename CompletionHandler>
     auto async_receive(CompletionHandler&& handler)
     {
         return net::async_initiate<CompletionHandler, void(std::error_code, json)>(
-            initiate_async_receive(this), handler);
+            initiate_async_receive<parse_json>(this), handler);
+    }
+
+    // Receives a varlink call, parsed in a single pass without building the json of the
+    // whole message. A message that isn't a valid call fails with net::error::invalid_argument.
+    template <typename CompletionHandler>
+    auto async_receive_call(CompletionHandler&& handler)
+    {
+        return net::async_initiate<CompletionHandler, void(std::error_code, basic_varlink_message)>(
+            initiate_async_receive<parse_call>(this), handler);
     }
 
     void send(const json& message)
     {
-        const auto m = message.dump();
-        const auto size = m.size() + 1; // Include \0
+        auto m = detail::buffer_pool::acquire();
+        detail::dump_into(message, m);
+        m.push_back('\0');
+        VARLINK_PROBE2(frame_send, this, m.size() - 1);
         size_t sent = 0;
-        while (sent < size) {
-            sent += stream.send(net::buffer(m.data() + sent, size - sent));
+        while (sent < m.size()) {
+            sent += stream.send(net::buffer(m.data() + sent, m.size() - sent));
         }
+        on_sent(sent, 0);
+        detail::buffer_pool::release(std::move(m));
     }
 
     [[nodiscard]] json receive()
     {
         std::error_code ec{};
-        std::optional<json> j = read_next_message(ec);
+        std::optional<json> j = read_next_message<parse_json>(ec);
         while (not j and not ec) {
-            const auto bytes_read = stream.receive(
-                net::buffer(&(*read_end), static_cast<size_t>(readbuf.end() - read_end)));
-            read_end += static_cast<ptrdiff_t>(bytes_read);
-            j = read_next_message(ec);
+            const auto buffer = prepare_read(ec);
+            if (ec) { throw std::system_error(ec); }
+            on_received(stream.receive(buffer));
+            j = read_next_message<parse_json>(ec);
+        }
+        if (ec == net::error::message_size) { throw std::system_error(ec); }
+        if (ec) {
+            throw std::invalid_argument(
+                std::string(readbuf.data() + read_pos, readbuf.data() + read_end));
         }
-        if (ec) { throw std::invalid_argument(std::string(readbuf.begin(), read_end)); }
         else {
-            return j.value();
+            return std::move(j.value());
         }
     }
 
   private:
-    std::optional<json> read_next_message(std::error_code& ec)
+    struct parse_json {
+        using result_type = json;
+        static constexpr bool traced = false;
+        static std::optional<json> parse(const char* begin, const char* end)
+        {
+            try {
+                return json::parse(begin, end);
+            }
+            catch (json::parse_error&) {
+                return std::nullopt;
+            }
+        }
+    };
+
+    struct parse_call {
+        using result_type = basic_varlink_message;
+        static constexpr bool traced = true;
+        static std::optional<basic_varlink_message> parse(const char* begin, const char* end)
+        {
+            return detail::parse_call(begin, end);
+        }
+    };
+
+    // Returns std::nullopt if there is no complete message in the buffer. If the next
+    // message can't be parsed, ec is set and an empty result returned.
+    template <typename Parser>
+    std::optional<typename Parser::result_type> read_next_message(std::error_code& ec)
     {
         ec = std::error_code{};
-        const auto next_message_end = std::find(readbuf.begin(), read_end, '\0');
-        if (next_message_end == read_end) { return std::nullopt; }
-        const auto message = std::string(readbuf.begin(), next_message_end);
-        read_end = std::copy(next_message_end + 1, read_end, readbuf.begin());
-
-        try {
-            return json::parse(message);
+        const char* message_begin = readbuf.data() + read_pos;
+        const char* buffer_end = readbuf.data() + read_end;
+        const auto next_message_end = std::find(message_begin, buffer_end, '\0');
+        if (next_message_end == buffer_end) { return std::nullopt; }
+        read_pos = static_cast<size_t>(next_message_end - readbuf.data()) + 1;
+        const auto message_size = static_cast<size_t>(next_message_end - message_begin);
+        VARLINK_PROBE2(frame_receive, this, message_size);
+        // A limit below the buffer size lets whole messages in that are too large
+        if (message_size > max_message_size_) {
+            ec = net::error::message_size;
+            return typename Parser::result_type{};
         }
-        catch (json::parse_error&) {
+
+#ifdef VARLINK_ENABLE_TRACING
+        received_call_ = Parser::traced ? detail::trace_sample() : 0;
+        const detail::trace_scope scope{received_call_};
+        const detail::trace_span span{"receive"};
+#endif
+        auto message = Parser::parse(message_begin, next_message_end);
+        if (not message) {
             ec = net::error::invalid_argument;
-            return json{};
+            message.emplace();
         }
-    };
+        return message;
+    }
+
+    // Returns the free space behind the buffered data. Only called when there is no
+    // complete message left in the buffer, so an empty buffer can be rewound for free
+    // and drops back to its initial size after a large message.
+    net::mutable_buffer prepare_read(std::error_code& ec)
+    {
+        ec = std::error_code{};
+        if (read_pos == read_end) {
+            read_pos = read_end = 0;
+            if (readbuf.size() > initial_buffer_size) {
+                readbuf = byte_buffer(initial_buffer_size);
+            }
+        }
+        else if (readbuf.size() - read_end < readbuf.size() / 8) {
+            std::copy(
+                readbuf.begin() + static_cast<ptrdiff_t>(read_pos),
+                readbuf.begin() + static_cast<ptrdiff_t>(read_end),
+                readbuf.begin());
+            read_end -= std::exchange(read_pos, 0);
+        }
+        // The buffered data is the start of a message that is still incomplete
+        if (read_end - read_pos > max_message_size_) {
+            ec = net::error::message_size;
+            return net::buffer(readbuf.data(), 0);
+        }
+        if (read_end == readbuf.size()) {
+            readbuf.resize(std::min(readbuf.size() * 2, max_message_size_ + 1)); // Include \0
+        }
+        return net::buffer(readbuf.data() + read_end, readbuf.size() - read_end);
+    }
 
+    // Called on write_strand when no write is in progress and write_queue isn't empty.
+    // The batch is owned by the write operation, so its handlers are destroyed along with
+    // it if the io_context shuts down first. Its storage is recycled afterwards.
+    void start_write()
+    {
+        auto batch = std::exchange(write_queue, std::move(write_spare));
+        write_buffers.clear();
+        for (const auto& w : batch) {
+            write_buffers.push_back(net::buffer(w.data));
+        }
+        ++writes_;
+        frames_ += batch.size();
+        net::async_write(
+            stream,
+            write_buffers,
+            net::bind_executor(
+                write_strand,
+                [this, batch = std::move(batch)](std::error_code ec, size_t n) mutable {
+                    const auto frames = batch.size();
+                    on_sent(n, frames);
+                    VARLINK_PROBE3(write_done, this, n, batch.size());
+                    for (auto& w : batch) {
+#ifdef VARLINK_ENABLE_TRACING
+                        w.queued.record("write");
+#endif
+                        detail::buffer_pool::release(std::move(w.data));
+                        w.handler(ec);
+                    }
+                    batch.clear();
+                    write_spare = std::move(batch);
+                    if (write_queue.empty()) { writing = false; }
+                    else {
+                        start_write();
+                    }
+                    pending_sends_.completed(frames);
+                }));
+    }
+
+    template <typename Parser>
     class initiate_async_receive {
       private:
         json_connection* self_;
@@ -134,35 +374,72 @@ class json_connection {
         template <typename CompletionHandler>
         void operator()(CompletionHandler&& handler)
         {
+            using result_type = typename Parser::result_type;
             std::error_code _ec;
-            if (auto _message = self_->read_next_message(_ec); _message) {
+            if (auto _message = self_->template read_next_message<Parser>(_ec); _message) {
                 net::post(
                     self_->get_executor(),
-                    [_ec, _message, handler = std::forward<CompletionHandler>(handler)]() mutable {
+                    [_ec,
+                     _message = std::move(_message),
+#ifdef VARLINK_ENABLE_TRACING
+                     call = self_->received_call_,
+#endif
+                     handler = std::forward<CompletionHandler>(handler)]() mutable {
+#ifdef VARLINK_ENABLE_TRACING
+                        const detail::trace_scope scope{call};
+#endif
                         handler(_ec, std::move(_message.value()));
                     });
             }
+            else if (const auto buffer = self_->prepare_read(_ec); _ec) {
+                net::post(
+                    self_->get_executor(),
+                    [_ec, handler = std::forward<CompletionHandler>(handler)]() mutable {
+                        handler(_ec, result_type{});
+                    });
+            }
             else {
                 self_->stream.async_receive(
-                    net::buffer(
-                        &(*self_->read_end),
-                        static_cast<size_t>(self_->readbuf.end() - self_->read_end)),
+                    buffer,
                     [self = self_, handler = std::forward<CompletionHandler>(handler)](
                         std::error_code ec, size_t n) mutable {
-                        if (ec) { handler(ec, json{}); }
+                        if (ec) { handler(ec, result_type{}); }
                         else {
-                            self->read_end += static_cast<ptrdiff_t>(n);
-                            if (auto message = self->read_next_message(ec); message) {
-                                handler(ec, message.value());
+                            self->on_received(n);
+                            if (auto message = self->template read_next_message<Parser>(ec);
+                                message) {
+#ifdef VARLINK_ENABLE_TRACING
+                                const detail::trace_scope scope{self->received_call_};
+#endif
+                                handler(ec, std::move(message.value()));
                             }
                             else {
-                                self->async_receive(std::forward<CompletionHandler>(handler));
+                                initiate_async_receive{self}(std::move(handler));
                             }
                         }
                     });
             }
         }
     };
+    class initiate_async_connect {
+      private:
+        json_connection* self_;
+
+      public:
+        explicit initiate_async_connect(json_connection* self) : self_(self) {}
+
+        template <typename CompletionHandler>
+        void operator()(CompletionHandler&& handler, const endpoint_type& endpoint)
+        {
+            self_->stream.async_connect(
+                endpoint,
+                [self = self_, handler = std::forward<CompletionHandler>(handler)](
+                    std::error_code ec) mutable {
+                    if (not ec) { self->disable_nagle(ec); }
+                    handler(ec);
+                });
+        }
+    };
     class initiate_async_send {
       private:
         json_connection* self_;
@@ -173,18 +450,52 @@ class json_connection {
         template <typename CompletionHandler>
         void operator()(CompletionHandler&& handler, const json& message)
         {
-            self_->write_strand.push(
-                [self = self_, &message, handler = std::forward<CompletionHandler>(handler)]() mutable {
-                    auto m = std::make_unique<std::string>(message.dump());
-                    auto buffer = net::buffer(m->data(), m->size() + 1);
-                    net::async_write(
-                        self->stream,
-                        buffer,
-                        [handler = std::forward<CompletionHandler>(handler), self, m = std::move(m)](
-                            std::error_code ec, size_t) mutable {
-                            self->write_strand.next();
-                            handler(ec);
-                        });
+#ifdef VARLINK_ENABLE_TRACING
+            const detail::trace_span span{"send"};
+#endif
+            auto data = detail::buffer_pool::acquire();
+            detail::dump_into(message, data);
+            queue(std::move(data), std::forward<CompletionHandler>(handler));
+        }
+
+        template <typename CompletionHandler>
+        void operator()(CompletionHandler&& handler, std::string_view frame)
+        {
+#ifdef VARLINK_ENABLE_TRACING
+            const detail::trace_span span{"send"};
+#endif
+            auto data = detail::buffer_pool::acquire();
+            data.append(frame);
+            queue(std::move(data), std::forward<CompletionHandler>(handler));
+        }
+
+      private:
+        template <typename CompletionHandler>
+        void queue(std::string&& data, CompletionHandler&& handler)
+        {
+            data.push_back('\0');
+            VARLINK_PROBE2(frame_send, self_, data.size() - 1);
+            self_->pending_sends_.started();
+            net::post(
+                self_->write_strand,
+                [self = self_,
+                 data = std::move(data),
+#ifdef VARLINK_ENABLE_TRACING
+                 queued = detail::trace_mark{},
+#endif
+                 handler = std::forward<CompletionHandler>(handler)]() mutable {
+                    self->write_queue.push_back({std::move(data), std::move(handler)});
+#ifdef VARLINK_ENABLE_TRACING
+                    self->write_queue.back().queued = queued;
+#endif
+#ifdef VARLINK_ENABLE_METRICS
+                    if (self->metrics_ != nullptr) { self->metrics_->replies_queued(1); }
+#endif
+                    if (not self->writing) {
+                        // Deferred, so that sends already queued on the strand join this write
+                        self->writing = true;
+                        net::post(self->write_strand, [self]() { self->start_write(); });
+                    }
                 });
         }
     };
@@ -47,12 +47,24 @@ class varlink_server {
         std::visit([&](auto&& s) { s.async_serve_forever(); }, server);
     }
 
+    // Only sessions accepted afterwards use the new depth
+    void set_pipeline_depth(size_t depth)
+    {
+        std::visit([&](auto&& s) { s.set_pipeline_depth(depth); }, server);
+    }
+
     template <typename... Args>
     void add_interface(Args&&... args)
     {
         service.add_interface(std::forward<Args>(args)...);
     }
 
+#ifdef VARLINK_ENABLE_METRICS
+    void add_metrics_interface() { service.add_metrics_interface(); }
+
+    [[nodiscard]] metrics_snapshot metrics() const { return service.metrics(); }
+#endif
+
     auto get_executor()
     {
         return std::visit([](auto&& s) { return s.get_executor(); }, server);
@@ -1,6 +1,11 @@
 #ifndef LIBVARLINK_SERVER_SESSION_HPP
 #define LIBVARLINK_SERVER_SESSION_HPP
 
+#include <deque>
+#include <mutex>
+#include <variant>
+#include <varlink/detail/counter.hpp>
+#include <varlink/detail/probes.hpp>
 #include <varlink/json_connection.hpp>
 #include <varlink/service.hpp>
 
@@ -20,52 +25,187 @@ class server_session : public std::enable_shared_from_this<server_session<Protoc
 
     executor_type get_executor() { return connection.get_executor(); }
 
+    [[nodiscard]] size_t max_message_size() const noexcept { return connection.max_message_size(); }
+    void set_max_message_size(size_t size) noexcept { connection.set_max_message_size(size); }
+
+    // Maximum number of calls in flight. With a depth above 1, the session keeps reading
+    // requests while earlier calls are still being processed. Replies of a call are held
+    // back until all calls received before it are complete, so they leave in request order.
+    // May be set while the session is running, it applies from the next received call on.
+    [[nodiscard]] size_t pipeline_depth() const noexcept { return pipeline_depth_.load(); }
+    void set_pipeline_depth(size_t depth) noexcept
+    {
+        pipeline_depth_.store(std::max<size_t>(depth, 1));
+    }
+
   private:
+#ifdef VARLINK_ENABLE_METRICS
+    // Outlives the connection, which counts into it
+    std::shared_ptr<detail::transport_metrics> metrics_;
+#endif
     connection_type connection;
     varlink_service& service_;
+
+    // The replies of org.varlink.service come serialized from the service
+    using reply_type = std::variant<json, serialized_reply>;
+
+    struct pending_call {
+        std::vector<reply_type> replies{};
+        bool done{false};
+#ifdef VARLINK_ENABLE_TRACING
+        // Held back replies are sent while another call is current
+        uint64_t trace_call{detail::trace_current_call()};
+#endif
+    };
+    // Reply callbacks may run on any thread, so the pipeline state is guarded by a mutex.
+    // The front of pending_calls is the oldest call, its replies are sent immediately.
+    std::mutex pipeline_mutex{};
+    detail::atomic_value<size_t> pipeline_depth_{1};
+    // Set by a failed write, guarded by pipeline_mutex as well
     std::error_code send_ec{};
+    std::deque<pending_call> pending_calls{};
+    uint64_t first_pending{0};
+    uint64_t next_call{0};
+    bool receiving{false};
 
   public:
     explicit server_session(socket_type socket, varlink_service& service)
         : connection(std::move(socket)), service_(service)
     {
+#ifdef VARLINK_ENABLE_METRICS
+        metrics_ = service_.transport_counters();
+        connection.set_metrics(metrics_.get());
+        metrics_->session_opened();
+#endif
+    }
+
+    ~server_session()
+    {
+#ifdef VARLINK_ENABLE_METRICS
+        metrics_->session_closed();
+#endif
+        VARLINK_PROBE1(session_close, this);
     }
 
     server_session(const server_session&) = delete;
     server_session& operator=(const server_session&) = delete;
-    server_session(server_session&&) noexcept = default;
-    server_session& operator=(server_session&&) noexcept = default;
+    server_session(server_session&&) = delete;
+    server_session& operator=(server_session&&) = delete;
 
     void start()
     {
-        connection.async_receive([self = shared_from_this()](auto ec, auto&& j) {
-            if (ec) return;
-            try {
-                const basic_varlink_message message{j};
-                self->service_.message_call(message, [self](const json& reply) {
-                    if (self->send_ec) { throw std::system_error(self->send_ec); }
-                    if (reply.is_object()) {
-                        auto m = std::make_unique<json>(reply);
-                        self->async_send_reply(std::move(m));
+        {
+            std::lock_guard lock(pipeline_mutex);
+            receiving = true;
+        }
+        async_receive_call();
+    }
+
+  private:
+    // Invalid messages end the session once the previous calls are done
+    void async_receive_call()
+    {
+        connection.async_receive_call(
+            [self = shared_from_this()](std::error_code ec, basic_varlink_message message) {
+                if (ec) return;
+                // Like a failed receive, anything thrown here (e.g. bad_alloc while queueing
+                // the call) ends the session once its calls are done
+                try {
+                    self->dispatch(std::move(message));
+                }
+                catch (...) {
+                }
+            });
+    }
+
+    void dispatch(basic_varlink_message&& message)
+    {
+        uint64_t call{};
+        bool receive_next{false};
+        {
+            std::lock_guard lock(pipeline_mutex);
+            receiving = false;
+            call = next_call++;
+            pending_calls.emplace_back();
+            receive_next = receiving = (pending_calls.size() < pipeline_depth_.load());
+        }
+        if (receive_next) { async_receive_call(); }
+
+        service_.message_call(std::move(message), reply_sender{shared_from_this(), call});
+    }
+
+    // Passes the replies of a call to the session, serialized ones included
+    struct reply_sender {
+        static constexpr bool accepts_serialized = true;
+        std::shared_ptr<server_session> self;
+        uint64_t call;
+
+        void operator()(json&& reply) const { self->on_reply(call, std::move(reply)); }
+        void operator()(serialized_reply&& reply) const { self->on_reply(call, std::move(reply)); }
+    };
+
+    void on_reply(uint64_t call, reply_type&& reply)
+    {
+        const auto* message = std::get_if<json>(&reply);
+        const bool final = (message == nullptr) or not reply_continues(*message);
+        // Oneway calls reply with null, which isn't sent
+        const bool send = (message == nullptr) or message->is_object();
+        bool receive_next{false};
+        {
+            std::lock_guard lock(pipeline_mutex);
+            if (send_ec) { throw std::system_error(send_ec); }
+            if (call == first_pending) {
+                if (send) { async_send_reply(reply); }
+                if (final) {
+                    pop_pending_call();
+                    // Flush the calls that were waiting for this one
+                    while (not pending_calls.empty()) {
+                        auto& next = pending_calls.front();
+                        for (const auto& r : next.replies) {
+#ifdef VARLINK_ENABLE_TRACING
+                            const detail::trace_scope scope{next.trace_call};
+#endif
+                            async_send_reply(r);
+                        }
+                        next.replies.clear();
+                        if (not next.done) break;
+                        pop_pending_call();
                     }
-                    if (not reply_continues(reply)) { self->start(); }
-                });
+                }
+            }
+            else {
+                auto& pending = pending_calls[call - first_pending];
+                if (send) { pending.replies.push_back(std::move(reply)); }
+                pending.done = final;
             }
-            catch (...) {
+            if (final and not receiving and pending_calls.size() < pipeline_depth_.load()) {
+                receive_next = receiving = true;
             }
-        });
+        }
+        if (receive_next) { async_receive_call(); }
     }
 
-  private:
-    void async_send_reply(std::unique_ptr<json> message)
+    void pop_pending_call()
+    {
+        pending_calls.pop_front();
+        ++first_pending;
+    }
+
+    void async_send_reply(const reply_type& reply)
     {
-        auto& data = *message;
-        connection.async_send(data, [m = std::move(message), self = shared_from_this()](auto ec) {
+        auto handler = [self = shared_from_this()](auto ec) {
             if (ec) {
                 self->connection.cancel();
+                std::lock_guard lock(self->pipeline_mutex);
                 self->send_ec = ec;
             }
-        });
+        };
+        if (const auto* serialized = std::get_if<serialized_reply>(&reply)) {
+            connection.async_send_frame(*serialized->frame, std::move(handler));
+        }
+        else {
+            connection.async_send(std::get<json>(reply), std::move(handler));
+        }
     }
 };
 
@@ -1,42 +1,139 @@
 #ifndef LIBVARLINK_SERVICE_HPP
 #define LIBVARLINK_SERVICE_HPP
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
 #include <varlink/detail/message.hpp>
+#ifdef VARLINK_ENABLE_METRICS
+#include <varlink/detail/metrics.hpp>
+#endif
+#include <varlink/detail/probes.hpp>
+#ifdef VARLINK_ENABLE_TRACING
+#include <varlink/detail/trace.hpp>
+#endif
+#include <varlink/detail/validator.hpp>
 #include <varlink/detail/varlink_error.hpp>
 #include <varlink/interface.hpp>
 
-#define varlink_callback                               \
-    ([[maybe_unused]] const varlink::json& parameters, \
-     [[maybe_unused]] varlink::callmode mode,          \
-     [[maybe_unused]] const varlink::reply_function& send_reply)
+#define varlink_callback                                 \
+    ([[maybe_unused]] const ::varlink::json& parameters, \
+     [[maybe_unused]] ::varlink::callmode mode,          \
+     [[maybe_unused]] const ::varlink::reply_function& send_reply)
 
 namespace varlink {
 
-using reply_function = std::function<void(json::object_t, bool)>;
+// Replies are moved through to the connection, pass a copy to send an object that is kept
+using reply_function = std::function<void(json::object_t&&, bool)>;
 
 using callback_function = std::function<void(const json&, callmode, const reply_function&)>;
 using callback_map = std::map<std::string, callback_function>;
 
+// A callback that takes its parameters by value, like the ones generated by
+// varlink_wrapper(<interface> TYPED). Stored in a callback_map like any other callback,
+// message_call moves the parameters out of messages it is passed as rvalues. The callable
+// must take both const json& and json&&, the first one is used for all other messages.
+class consuming_callback {
+  public:
+    using consuming_function = std::function<void(json&&, callmode, const reply_function&)>;
+
+    template <typename Callable>
+    explicit consuming_callback(Callable callback)
+        : consume_(callback), copy_(std::move(callback))
+    {
+    }
+
+    void operator()(const json& parameters, callmode mode, const reply_function& send_reply) const
+    {
+        copy_(parameters, mode, send_reply);
+    }
+
+    void operator()(json&& parameters, callmode mode, const reply_function& send_reply) const
+    {
+        consume_(std::move(parameters), mode, send_reply);
+    }
+
+  private:
+    consuming_function consume_;
+    callback_function copy_;
+};
+
+// A reply frame that was serialized ahead of time, without the terminating \0. Shared, so
+// that held back replies keep the frame alive while the service replaces it.
+struct serialized_reply {
+    std::shared_ptr<const std::string> frame;
+};
+
+// Reply handlers opt in to serialized replies with a static constexpr bool
+// accepts_serialized = true, and must then be callable with a serialized_reply
+template <typename ReplyHandler, typename = void>
+struct accepts_serialized_reply : std::false_type {};
+template <typename ReplyHandler>
+struct accepts_serialized_reply<ReplyHandler, std::enable_if_t<ReplyHandler::accepts_serialized>>
+    : std::true_type {};
+
+// Whether message_call validates the parameters and replies of an interface's methods
+// against its type specs. Only callbacks that check the types on their own, like the
+// ones generated by varlink_wrapper(<interface> TYPED), may be added without validation.
+enum class validation { full, none };
+
 class varlink_service {
     struct interface_entry {
         interface_entry(varlink_interface spec, callback_map callbacks)
             : spec_(std::move(spec)), callbacks_(std::move(callbacks))
         {
+            std::stringstream ss;
+            ss << spec_;
+            description_reply_ = {{"description", ss.str()}};
+            description_frame_ = serialize_reply(json::object_t(description_reply_));
         }
 
         auto* operator->() const { return &spec_; }
         auto& operator*() const { return spec_; }
 
-        [[nodiscard]] auto& callback(const std::string& methodname) const
+        // The reply to GetInterfaceDescription, interfaces can't change once added
+        [[nodiscard]] const json::object_t& description_reply() const
+        {
+            return description_reply_;
+        }
+        [[nodiscard]] const serialized_reply& description_frame() const
+        {
+            return description_frame_;
+        }
+
+        [[nodiscard]] const callback_function* find_callback(std::string_view methodname) const
         {
-            const auto callback_entry = callbacks_.find(methodname);
-            if (callback_entry == callbacks_.end()) throw std::bad_function_call{};
-            return callback_entry->second;
+            const auto callback_entry = callbacks_.find(std::string(methodname));
+            if (callback_entry == callbacks_.end()) return nullptr;
+            return &callback_entry->second;
         }
 
       private:
         varlink_interface spec_;
         callback_map callbacks_;
+        json::object_t description_reply_{};
+        serialized_reply description_frame_{};
+    };
+
+    // Returns the serialized reply to a call with parameters, or no frame to let the
+    // callback reply
+    using cached_reply_function = serialized_reply (*)(const varlink_service&, const json&);
+
+    // Everything message_call needs to know about a method, resolved at add_interface
+    struct dispatch_entry {
+        const callback_function* callback; // nullptr if the method isn't implemented
+        const consuming_callback* consuming; // Set if the callback is one
+        detail::type_validator parameters;
+        detail::type_validator returns;
+        bool validate;
+#ifdef VARLINK_ENABLE_METRICS
+        detail::method_metrics* metrics;
+#endif
+        // Set for the methods of org.varlink.service, whose replies are kept serialized
+        cached_reply_function cached{nullptr};
     };
 
   public:
@@ -49,13 +146,34 @@ class varlink_service {
 
   private:
     description desc;
-    std::vector<interface_entry> interfaces{};
+    // The reply to GetInfo, updated by add_interface
+    json::object_t info_reply{};
+    serialized_reply info_frame{};
+    // Entries must not move, the lookup tables below point into them
+    std::deque<interface_entry> interfaces{};
+    std::deque<std::string> method_names{};
+    std::unordered_map<std::string_view, const interface_entry*> interface_index{};
+    std::unordered_map<std::string_view, dispatch_entry> dispatch_table{};
+#ifdef VARLINK_ENABLE_METRICS
+    // Entries must not move either, dispatch entries point to them
+    std::deque<detail::method_metrics> method_counters{};
+    mutable detail::error_metrics error_counters{};
+    // Shared with the sessions, which may be destroyed after the service
+    std::shared_ptr<detail::transport_metrics> transport_counters_{
+        std::make_shared<detail::transport_metrics>()};
+#endif
 
-    [[nodiscard]] auto find_interface(std::string_view ifname) const
+    [[nodiscard]] const interface_entry* find_interface(std::string_view ifname) const
     {
-        return std::find_if(interfaces.cbegin(), interfaces.cend(), [&ifname](auto& i) {
-            return (ifname == i->name());
-        });
+        const auto entry = interface_index.find(ifname);
+        return (entry != interface_index.end()) ? entry->second : nullptr;
+    }
+
+    static serialized_reply serialize_reply(json::object_t&& parameters)
+    {
+        json::object_t reply{};
+        reply.emplace("parameters", std::move(parameters));
+        return {std::make_shared<const std::string>(json(std::move(reply)).dump())};
     }
 
   public:
@@ -66,54 +184,152 @@ class varlink_service {
     varlink_service(varlink_service&& src) = delete;
     varlink_service& operator=(varlink_service&&) = delete;
 
+    // Calls replySender with each reply. A replySender that accepts serialized replies (see
+    // accepts_serialized_reply) gets the replies the service keeps serialized that way.
     template <typename ReplyHandler>
     void message_call(const basic_varlink_message& message, ReplyHandler&& replySender) const noexcept
     {
-        const auto error = [=](const std::string& what, const json& params) {
+        call_method(message, nullptr, std::forward<ReplyHandler>(replySender));
+    }
+
+    // Consuming callbacks get the parameters moved out of the message
+    template <typename ReplyHandler>
+    void message_call(basic_varlink_message&& message, ReplyHandler&& replySender) const noexcept
+    {
+        call_method(message, &message, std::forward<ReplyHandler>(replySender));
+    }
+
+  private:
+    // Consuming callbacks get the parameters of a consumable message, which is the message
+    template <typename ReplyHandler>
+    void call_method(
+        const basic_varlink_message& message,
+        basic_varlink_message* consumable,
+        ReplyHandler&& replySender) const noexcept
+    {
+        const auto& fqmethod = message.json_data()["method"].get_ref<const std::string&>();
+        VARLINK_PROBE1(call_start, fqmethod.c_str());
+#if defined(VARLINK_ENABLE_METRICS)
+        const auto started = std::chrono::steady_clock::now();
+#elif defined(VARLINK_ENABLE_USDT)
+        const auto started = detail::probe_start();
+#endif
+#ifdef VARLINK_ENABLE_METRICS
+        detail::method_metrics* call_metrics{nullptr};
+#endif
+#ifdef VARLINK_ENABLE_TRACING
+        // Set by the connection that received the message
+        const auto call = detail::trace_current_call();
+#endif
+        const auto error = [&, replySender](const std::string& what, const json& params) {
             assert(params.is_object());
-            replySender({{"error", what}, {"parameters", params}});
+#ifdef VARLINK_ENABLE_TRACING
+            const detail::trace_span span{"reply", call};
+#endif
+#ifdef VARLINK_ENABLE_METRICS
+            error_counters.record(what);
+            if (call_metrics != nullptr) { call_metrics->record_reply(started, true); }
+#endif
+            VARLINK_PROBE3(call_done, fqmethod.c_str(), detail::elapsed_ns(started), what.c_str());
+            replySender(json{{"error", what}, {"parameters", params}});
         };
-        const auto ifname = message.interface();
-        const auto methodname = message.method();
-        const auto interface_it = find_interface(ifname);
-        if (interface_it == interfaces.cend()) {
-            error("org.varlink.service.InterfaceNotFound", {{"interface", ifname}});
+        const auto dispatch_it = dispatch_table.find(fqmethod);
+        if (dispatch_it == dispatch_table.end()) {
+            const auto ifname = message.interface();
+            if (find_interface(ifname) == nullptr) {
+                error("org.varlink.service.InterfaceNotFound", {{"interface", ifname}});
+            }
+            else {
+                error("org.varlink.service.MethodNotFound", {{"method", fqmethod}});
+            }
             return;
         }
 
+        const auto& entry = dispatch_it->second;
+#ifdef VARLINK_ENABLE_METRICS
+        call_metrics = entry.metrics;
+        call_metrics->record_call();
+#endif
         try {
-            const auto& interface = *interface_it;
-            const auto& m = interface->method(methodname);
-            interface->validate(message.parameters(), m.method_parameter_type());
+            if (entry.validate) {
+#ifdef VARLINK_ENABLE_TRACING
+                const detail::trace_span span{"validate", call};
+#endif
+                entry.parameters.validate(message.parameters());
+            }
+            if constexpr (accepts_serialized_reply<std::decay_t<ReplyHandler>>::value) {
+                if (entry.cached != nullptr and message.mode() == callmode::basic) {
+                    if (auto reply = entry.cached(*this, message.parameters()); reply.frame) {
+#ifdef VARLINK_ENABLE_TRACING
+                        const detail::trace_span span{"reply", call};
+#endif
+                        replySender(std::move(reply));
+#ifdef VARLINK_ENABLE_METRICS
+                        entry.metrics->record_reply(started, false);
+#endif
+                        VARLINK_PROBE3(call_done, fqmethod.c_str(), detail::elapsed_ns(started), "");
+                        return;
+                    }
+                }
+            }
+            if (entry.callback == nullptr) throw std::bad_function_call{};
             // This is not an asynchronous callback and exceptions
             // will propagate up to the outer try-catch in this fn.
             // TODO: This isn't true if the callback dispatches async ops
             auto handler = [mode = message.mode(),
-                            interface,
-                            &return_type = m.method_return_type(),
+                            &entry,
+#if defined(VARLINK_ENABLE_METRICS) or defined(VARLINK_ENABLE_USDT)
+                            started,
+#endif
+#ifdef VARLINK_ENABLE_USDT
+                            // The key is a std::string of the service, the message may be gone
+                            method = dispatch_it->first.data(),
+#endif
+#ifdef VARLINK_ENABLE_TRACING
+                            call,
+#endif
                             replySender = std::forward<ReplyHandler>(replySender)](
-                               const json::object_t& params, bool continues) mutable {
-                interface->validate(params, return_type);
+                               json::object_t&& params, bool continues) mutable {
+#ifdef VARLINK_ENABLE_TRACING
+                // The callback may reply from another thread
+                const detail::trace_scope scope{call};
+                const detail::trace_span span{"reply", call};
+#endif
+                if (entry.validate) { entry.returns.validate(params); }
 
-                if (mode == callmode::oneway) { replySender(nullptr); }
-                else if (mode == callmode::more) {
-                    replySender({{"parameters", params}, {"continues", continues}});
-                }
-                else if (continues) { // and not more
+                if (mode == callmode::oneway) { replySender(json(nullptr)); }
+                else if (continues and mode != callmode::more) {
                     throw std::bad_function_call{};
                 }
                 else {
-                    replySender({{"parameters", params}});
+                    // Not an initializer list, that would copy the parameters
+                    json::object_t reply{};
+                    reply.emplace("parameters", std::move(params));
+                    if (mode == callmode::more) { reply.emplace("continues", continues); }
+                    replySender(json(std::move(reply)));
                 }
+                // Only once sent, a reply that failed to send ends the call with an error
+#ifdef VARLINK_ENABLE_METRICS
+                if (not continues) { entry.metrics->record_reply(started, false); }
+#endif
+#ifdef VARLINK_ENABLE_USDT
+                if (not continues) {
+                    VARLINK_PROBE3(call_done, method, detail::elapsed_ns(started), "");
+                }
+#endif
             };
-            auto& callback = interface.callback(methodname);
-            callback(message.parameters(), message.mode(), handler);
-        }
-        catch (std::out_of_range&) {
-            error("org.varlink.service.MethodNotFound", {{"method", ifname + '.' + methodname}});
+#ifdef VARLINK_ENABLE_TRACING
+            const detail::trace_span span{"callback", call};
+#endif
+            if (consumable != nullptr and entry.consuming != nullptr) {
+                (*entry.consuming)(consumable->take_parameters(), message.mode(), handler);
+            }
+            else {
+                (*entry.callback)(message.parameters(), message.mode(), handler);
+            }
         }
         catch (std::bad_function_call&) {
-            error("org.varlink.service.MethodNotImplemented", {{"method", ifname + '.' + methodname}});
+            error("org.varlink.service.MethodNotImplemented", {{"method", fqmethod}});
         }
         catch (invalid_parameter& e) {
             error("org.varlink.service.InvalidParameter", {{"parameter", e.what()}});
@@ -121,32 +337,92 @@ class varlink_service {
         catch (varlink_error& e) {
             error(e.what(), e.args());
         }
-        catch (std::system_error&) {
-            // All system_errors here are send-errors, so don't send anymore
+        catch (std::system_error& e) {
+            // All system_errors here are send-errors, so don't send anymore. The call ended
+            // without a reply though.
+#ifdef VARLINK_ENABLE_METRICS
+            call_metrics->record_reply(started, true);
+#endif
+            VARLINK_PROBE3(call_done, fqmethod.c_str(), detail::elapsed_ns(started), e.what());
         }
         catch (std::exception& e) {
             error("org.varlink.service.InternalError", {{"what", e.what()}});
         }
     }
 
-    void add_interface(varlink_interface&& interface, callback_map&& callbacks = {})
+  public:
+#ifdef VARLINK_ENABLE_METRICS
+    // Reads the counters while calls keep updating them, so the snapshot isn't atomic. It
+    // has an entry for every method of the service, errors appear once they occurred.
+    [[nodiscard]] metrics_snapshot metrics() const
     {
-        if (auto pos = find_interface(interface.name()); pos == interfaces.end()) {
-            for (auto& callback : callbacks) {
-                if (not interface.has_method(callback.first)) {
-                    throw std::invalid_argument("Callback for unknown method");
-                }
-            }
-            interfaces.emplace_back(std::move(interface), std::move(callbacks));
+        metrics_snapshot snapshot{};
+        snapshot.transport = transport_counters_->snapshot();
+        uint64_t replied{0};
+        for (const auto& [name, entry] : dispatch_table) {
+            const auto& stats =
+                snapshot.methods.emplace(name, entry.metrics->snapshot()).first->second;
+            snapshot.transport.calls_in_flight += stats.calls;
+            replied += stats.latency.count();
         }
-        else {
+        snapshot.transport.calls_in_flight -= std::min(replied, snapshot.transport.calls_in_flight);
+        error_counters.snapshot(snapshot.errors);
+        return snapshot;
+    }
+
+    // Updated by the sessions of the servers using this service
+    [[nodiscard]] const std::shared_ptr<detail::transport_metrics>& transport_counters() noexcept
+    {
+        return transport_counters_;
+    }
+
+    // Adds org.varlink.metrics, which replies to GetMetrics with the metrics() of this
+    // service. Not added by default, metrics may be more than a service wants to tell.
+    void add_metrics_interface();
+#endif
+
+    void add_interface(
+        varlink_interface&& interface,
+        callback_map&& callbacks = {},
+        validation checks = validation::full)
+    {
+        if (find_interface(interface.name()) != nullptr) {
             throw std::invalid_argument("Interface already exists!");
         }
+        for (auto& callback : callbacks) {
+            if (not interface.has_method(callback.first)) {
+                throw std::invalid_argument("Callback for unknown method");
+            }
+        }
+        const auto& entry = interfaces.emplace_back(std::move(interface), std::move(callbacks));
+        interface_index.emplace(entry->name(), &entry);
+        info_reply["interfaces"].push_back(entry->name());
+        info_frame = serialize_reply(json::object_t(info_reply));
+        entry->for_each_method([&](const detail::member& m) {
+            const auto& name = method_names.emplace_back(
+                std::string(entry->name()) + '.' + std::string(m.name));
+            const auto* callback = entry.find_callback(m.name);
+            dispatch_table.emplace(
+                name,
+                dispatch_entry{
+                    callback,
+                    callback ? callback->target<consuming_callback>() : nullptr,
+                    detail::type_validator(*entry, m.method_parameter_type()),
+                    detail::type_validator(*entry, m.method_return_type()),
+                    checks == validation::full,
+#ifdef VARLINK_ENABLE_METRICS
+                    &method_counters.emplace_back(),
+#endif
+                });
+        });
     }
 
-    void add_interface(std::string_view definition, callback_map&& callbacks = {})
+    void add_interface(
+        std::string_view definition,
+        callback_map&& callbacks = {},
+        validation checks = validation::full)
     {
-        add_interface(varlink_interface(definition), std::move(callbacks));
+        add_interface(varlink_interface(definition), std::move(callbacks), checks);
     }
 };
 } // namespace varlink
@@ -2,39 +2,107 @@
 #define LIBVARLINK_THREADED_SERVER_HPP
 
 #include <varlink/async_server.hpp>
+#include <varlink/detail/io_context_pool.hpp>
 #include <varlink/service.hpp>
 #include <varlink/uri.hpp>
 
 namespace varlink {
+enum class threading_model {
+    // All threads run a single io_context, any of them may process any session
+    shared_pool,
+    // Every thread runs its own io_context and sessions are assigned round-robin,
+    // so each session stays on the thread it was accepted for
+    io_context_per_thread,
+    // Like io_context_per_thread, but for TCP, every thread also runs its own SO_REUSEPORT
+    // acceptor and the kernel balances new connections. Unix sockets use a single
+    // acceptor with one accept in flight per thread instead.
+    acceptor_per_thread,
+};
+
 class threaded_server {
   private:
-    net::thread_pool ctx;
+    detail::io_context_pool ctx;
     varlink_service service;
-    async_server_variant server;
+    std::vector<async_server_variant> servers{};
 
     template <typename Endpoint>
     using protocol_t = typename std::decay_t<Endpoint>::protocol_type;
     template <typename Endpoint>
     using server_t = async_server<protocol_t<Endpoint>>;
 
-    auto make_async_server(const varlink_uri& uri)
+    static bool shards_sessions(threading_model model)
     {
-        return std::visit(
-            [&](auto&& sockaddr) -> async_server_variant {
-                return server_t<decltype(sockaddr)>({ctx, sockaddr}, service);
+        return model == threading_model::io_context_per_thread
+               or model == threading_model::acceptor_per_thread;
+    }
+
+    auto make_async_servers(const varlink_uri& uri, threading_model model)
+    {
+        std::vector<async_server_variant> result;
+        std::visit(
+            [&](auto&& sockaddr) {
+                using server_type = server_t<decltype(sockaddr)>;
+                using acceptor_type = typename server_type::acceptor_type;
+                if constexpr (std::is_same_v<protocol_t<decltype(sockaddr)>, net::ip::tcp>) {
+                    if (model == threading_model::acceptor_per_thread) {
+                        // Later acceptors bind to the port of the first (in case it was 0)
+                        auto endpoint = sockaddr;
+                        for (size_t i = 0; i < ctx.size(); i++) {
+                            auto acceptor = make_reuse_port_acceptor(ctx.executor_at(i), endpoint);
+                            endpoint = acceptor.local_endpoint();
+                            result.emplace_back(
+                                std::in_place_type<server_type>, std::move(acceptor), service);
+                        }
+                        return;
+                    }
+                }
+                result.emplace_back(
+                    std::in_place_type<server_type>,
+                    acceptor_type{ctx.get_executor(), sockaddr},
+                    service);
             },
             endpoint_from_uri(uri));
+        return result;
     }
 
   public:
-    threaded_server(const varlink_uri& uri, const varlink_service::description& description)
-        : ctx(4), service(description), server(make_async_server(uri))
+    static size_t default_thread_count() noexcept
     {
-        std::visit([&](auto&& s) { net::post(ctx, [&]() { s.async_serve_forever(); }); }, server);
+        return std::max(std::thread::hardware_concurrency(), 1U);
     }
 
-    threaded_server(std::string_view uri, const varlink_service::description& description)
-        : threaded_server(varlink_uri(uri), description)
+    threaded_server(
+        const varlink_uri& uri,
+        const varlink_service::description& description,
+        size_t threads = default_thread_count(),
+        threading_model model = threading_model::shared_pool)
+        : ctx(shards_sessions(model) ? threads : 1, shards_sessions(model) ? 1 : threads),
+          service(description),
+          servers(make_async_servers(uri, model))
+    {
+        const bool single_acceptor = (servers.size() == 1);
+        const size_t concurrent_accepts =
+            (model == threading_model::acceptor_per_thread and single_acceptor) ? ctx.size() : 1;
+        for (auto& server : servers) {
+            std::visit(
+                [&](auto&& s) {
+                    if (shards_sessions(model) and single_acceptor) {
+                        s.set_session_executor([this]() { return ctx.next_executor(); });
+                    }
+                    net::post(s.get_executor(), [&s, concurrent_accepts]() {
+                        s.async_serve_forever(concurrent_accepts);
+                    });
+                },
+                server);
+        }
+    }
+
+    threaded_server(
+        std::string_view uri,
+        const varlink_service::description& description,
+        size_t threads = default_thread_count(),
+        threading_model model = threading_model::shared_pool)
+        : threaded_server(varlink_uri(uri), description, threads, model)
     {
     }
 
@@ -43,12 +111,26 @@ class threaded_server {
     threaded_server(threaded_server&& src) noexcept = delete;
     threaded_server& operator=(threaded_server&& src) noexcept = delete;
 
+    // Only sessions accepted afterwards use the new depth
+    void set_pipeline_depth(size_t depth)
+    {
+        for (auto& server : servers) {
+            std::visit([&](auto&& s) { s.set_pipeline_depth(depth); }, server);
+        }
+    }
+
     template <typename... Args>
     void add_interface(Args&&... args)
     {
         service.add_interface(std::forward<Args>(args)...);
     }
 
+#ifdef VARLINK_ENABLE_METRICS
+    void add_metrics_interface() { service.add_metrics_interface(); }
+
+    [[nodiscard]] metrics_snapshot metrics() const { return service.metrics(); }
+#endif
+
     auto get_executor() { return ctx.get_executor(); }
 
     void stop() { ctx.stop(); }
@@ -0,0 +1,214 @@
+#ifndef LIBVARLINK_TYPED_HPP
+#define LIBVARLINK_TYPED_HPP
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <varlink/service.hpp>
+
+// Support code for the headers generated by varlink_wrapper(<interface> TYPED). Generated
+// structs decode themselves from json with the same checks type_validator does, throwing
+// invalid_parameter with the same names, so their callbacks are registered with
+// validation::none and skip the generic validation pass.
+namespace varlink {
+
+namespace detail {
+template <typename T>
+struct is_optional : std::false_type {};
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+// Maybe fields of recursive types
+template <typename T>
+struct is_optional<std::unique_ptr<T>> : std::true_type {};
+
+template <typename T>
+T& emplace_optional(std::optional<T>& out)
+{
+    return out.emplace();
+}
+
+template <typename T>
+T& emplace_optional(std::unique_ptr<T>& out)
+{
+    out = std::make_unique<T>();
+    return *out;
+}
+
+// Decoding from a mutable json moves its strings, objects and arrays into the result, the
+// json is left in a valid but unspecified state
+template <typename Json>
+using if_json = std::enable_if_t<std::is_same_v<std::remove_const_t<Json>, json>>;
+
+template <typename Json, typename = if_json<Json>>
+void decode(Json& j, bool& out, std::string_view name)
+{
+    if (not j.is_boolean()) throw invalid_parameter(std::string(name));
+    out = j.template get<bool>();
+}
+
+template <typename Json, typename = if_json<Json>>
+void decode(Json& j, int64_t& out, std::string_view name)
+{
+    if (not j.is_number_integer()) throw invalid_parameter(std::string(name));
+    out = j.template get<int64_t>();
+}
+
+template <typename Json, typename = if_json<Json>>
+void decode(Json& j, double& out, std::string_view name)
+{
+    if (not j.is_number()) throw invalid_parameter(std::string(name));
+    out = j.template get<double>();
+}
+
+template <typename Json, typename = if_json<Json>>
+void decode(Json& j, std::string& out, std::string_view name)
+{
+    if (not j.is_string()) throw invalid_parameter(std::string(name));
+    if constexpr (std::is_const_v<Json>) { out = j.template get_ref<const std::string&>(); }
+    else {
+        out = std::move(j.template get_ref<std::string&>());
+    }
+}
+
+template <typename Json, typename = if_json<Json>>
+void decode(Json& j, json& out, std::string_view name)
+{
+    if (j.is_null()) throw invalid_parameter(std::string(name));
+    if constexpr (std::is_const_v<Json>) { out = j; }
+    else {
+        out = std::move(j);
+    }
+}
+
+// Generated types
+template <typename Json, typename T, typename = if_json<Json>>
+void decode(Json& j, T& out, std::string_view)
+{
+    from_json(j, out);
+}
+
+// Declared before their definitions, so containers of containers find each other
+template <typename Json, typename T, typename = if_json<Json>>
+void decode(Json& j, std::vector<T>& out, std::string_view name);
+template <typename Json, typename T, typename = if_json<Json>>
+void decode(Json& j, std::map<std::string, T>& out, std::string_view name);
+
+template <typename Json, typename T, typename>
+void decode(Json& j, std::vector<T>& out, std::string_view name)
+{
+    if (not j.is_array()) throw invalid_parameter(j.dump());
+    out.clear();
+    out.reserve(j.size());
+    for (auto& element : j) {
+        // No references into std::vector<bool>
+        T value{};
+        decode(element, value, name);
+        out.push_back(std::move(value));
+    }
+}
+
+template <typename Json, typename T, typename>
+void decode(Json& j, std::map<std::string, T>& out, std::string_view name)
+{
+    if (not j.is_object()) throw invalid_parameter(j.dump());
+    out.clear();
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        decode(it.value(), out[it.key()], name);
+    }
+}
+
+template <typename Json, typename T>
+void decode_field(Json& j, std::string_view key, T& out)
+{
+    const auto value = j.find(key);
+    if constexpr (is_optional<T>::value) {
+        if (value == j.end() or value->is_null()) { out.reset(); }
+        else {
+            decode(*value, emplace_optional(out), key);
+        }
+    }
+    else {
+        if (value == j.end() or value->is_null()) throw invalid_parameter(std::string(key));
+        decode(*value, out, key);
+    }
+}
+
+inline void expect_object(const json& j)
+{
+    if (not j.is_object()) throw invalid_parameter(j.dump());
+}
+
+template <typename T>
+void encode_field(json::object_t& object, std::string_view key, const T& value)
+{
+    if constexpr (is_optional<T>::value) {
+        if (value) { object.emplace(key, *value); }
+    }
+    else {
+        object.emplace(key, value);
+    }
+}
+} // namespace detail
+
+template <typename T>
+[[nodiscard]] T decode_typed(const json& j)
+{
+    T out{};
+    from_json(j, out);
+    return out;
+}
+
+// Moves the strings, objects and arrays of j into the result
+template <typename T>
+[[nodiscard]] T decode_typed(json&& j)
+{
+    T out{};
+    from_json(j, out);
+    return out;
+}
+
+template <typename T>
+[[nodiscard]] json::object_t encode_typed(const T& value)
+{
+    json j = value;
+    return std::move(j.get_ref<json::object_t&>());
+}
+
+// Error reply of a generated error type, to be thrown from a callback
+template <typename Error>
+[[nodiscard]] varlink_error typed_error(const typename Error::parameters& parameters)
+{
+    return varlink_error(std::string(Error::name), json(parameters));
+}
+
+// Typed wrapper around a callback's send_reply. It refers to the callback's send_reply
+// until it is copied, copies own a copy of it and can be kept to reply after the callback
+// returned.
+template <typename Reply>
+class typed_reply {
+  public:
+    explicit typed_reply(const reply_function& send_reply) : send_reply_(&send_reply) {}
+
+    typed_reply(const typed_reply& other) : owned_(*other.send_reply_), send_reply_(&*owned_) {}
+    typed_reply& operator=(const typed_reply& other)
+    {
+        if (this != &other) {
+            owned_ = *other.send_reply_;
+            send_reply_ = &*owned_;
+        }
+        return *this;
+    }
+
+    void operator()(const Reply& reply, bool continues = false) const
+    {
+        (*send_reply_)(encode_typed(reply), continues);
+    }
+
+  private:
+    std::optional<reply_function> owned_{};
+    const reply_function* send_reply_;
+};
+} // namespace varlink
+
+#endif // LIBVARLINK_TYPED_HPP
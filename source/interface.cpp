@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <varlink/detail/scanner.hpp>
+#include <varlink/detail/validator.hpp>
 #include <varlink/interface.hpp>
 
 namespace varlink {
@@ -35,66 +36,13 @@ bool varlink_interface::has_member(std::string_view name, detail::MemberKind kin
     });
 }
 
-void varlink_interface::validate( // NOLINT(misc-no-recursion)
+void varlink_interface::validate(
     const json& data,
     const detail::type_spec& typespec,
     std::string_view name,
     bool collection) const
 {
-    auto is_primitive = [](const json& object, std::string_view type) {
-        return (type == "string" && object.is_string())
-            or (type == "int" && object.is_number_integer())
-            or (type == "float" && object.is_number()) or (type == "bool" && object.is_boolean())
-            or (type == "object" && !object.is_null());
-    };
-
-    if (typespec.is_enum() and data.is_string()) {
-        auto& enm = typespec.get<detail::vl_enum>();
-        auto s = data.get<std::string>();
-        auto matcher = [&s](auto& e) { return e == s; };
-        if (not std::any_of(enm.begin(), enm.end(), matcher)) {
-            throw invalid_parameter(data.dump());
-        }
-        return;
-    }
-    else if (typespec.dict_type and data.is_object()) {
-        for (const auto& val : data) {
-            validate(val, typespec, name, true);
-        }
-    }
-    else if (typespec.array_type and data.is_array()) {
-        for (const auto& val : data) {
-            validate(val, typespec, name, true);
-        }
-    }
-    else if (typespec.is_string() and (collection or not(typespec.array_type or typespec.dict_type))) {
-        const auto& valtype = typespec.get<detail::string_type>();
-        if (not is_primitive(data, valtype)) {
-            try {
-                validate(data, type(valtype).data, name);
-            }
-            catch (std::out_of_range&) {
-                throw invalid_parameter(std::string(name));
-            }
-        }
-    }
-    else if (typespec.is_struct() and data.is_object()) {
-        auto& strct = typespec.get<detail::vl_struct>();
-        for (const auto& param : strct) {
-            name = param.first;
-            auto spec = param.second;
-            if (not data.contains(name) or data[std::string(name)].is_null()) {
-                if (not spec.maybe_type) throw invalid_parameter(std::string(name));
-            }
-            else {
-                const auto& value = data[std::string(name)];
-                validate(value, spec, name); // throws on error
-            }
-        }
-    }
-    else {
-        throw invalid_parameter(data.dump());
-    }
+    detail::type_validator(*this, typespec, collection).validate(data, name);
 }
 
 std::ostream& operator<<(std::ostream& os, const varlink::varlink_interface& interface)
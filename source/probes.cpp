@@ -0,0 +1,58 @@
+// The probes of the varlink provider, see varlink/detail/probes.hpp. sys/sdt.h decides on its
+// first inclusion whether probes refer to semaphores, so it is only included here.
+#ifdef _SYS_SDT_H
+#error "sys/sdt.h must not be included before the varlink probes"
+#endif
+#define _SDT_HAS_SEMAPHORES 1 // NOLINT(bugprone-reserved-identifier) sys/sdt.h's interface
+#include <sys/sdt.h>
+#include <varlink/detail/probes.hpp>
+
+#define VARLINK_SEMAPHORE(name) \
+    volatile unsigned short varlink_##name##_semaphore __attribute__((section(".probes"))) = 0
+extern "C" {
+VARLINK_SEMAPHORE(session_accept);
+VARLINK_SEMAPHORE(session_close);
+VARLINK_SEMAPHORE(frame_receive);
+VARLINK_SEMAPHORE(frame_send);
+VARLINK_SEMAPHORE(write_done);
+VARLINK_SEMAPHORE(call_start);
+VARLINK_SEMAPHORE(call_done);
+}
+#undef VARLINK_SEMAPHORE
+
+namespace varlink::detail {
+void probe_session_accept(const void* session) noexcept
+{
+    DTRACE_PROBE1(varlink, session_accept, session);
+}
+
+void probe_session_close(const void* session) noexcept
+{
+    DTRACE_PROBE1(varlink, session_close, session);
+}
+
+void probe_frame_receive(const void* connection, size_t bytes) noexcept
+{
+    DTRACE_PROBE2(varlink, frame_receive, connection, bytes);
+}
+
+void probe_frame_send(const void* connection, size_t bytes) noexcept
+{
+    DTRACE_PROBE2(varlink, frame_send, connection, bytes);
+}
+
+void probe_write_done(const void* connection, size_t bytes, size_t frames) noexcept
+{
+    DTRACE_PROBE3(varlink, write_done, connection, bytes, frames);
+}
+
+void probe_call_start(const char* method) noexcept
+{
+    DTRACE_PROBE1(varlink, call_start, method);
+}
+
+void probe_call_done(const char* method, int64_t duration_ns, const char* error) noexcept
+{
+    DTRACE_PROBE3(varlink, call_done, method, duration_ns, error);
+}
+} // namespace varlink::detail
@@ -1,36 +1,81 @@
-#include <sstream>
+#include <org.varlink.metrics.varlink.hpp>
 #include <org.varlink.service.varlink.hpp>
 #include <varlink/service.hpp>
 
 namespace varlink {
-varlink_service::varlink_service(description Description) : desc(std::move(Description))
+varlink_service::varlink_service(description Description)
+    : desc(std::move(Description)),
+      info_reply{
+          {"vendor", desc.vendor},
+          {"product", desc.product},
+          {"version", desc.version},
+          {"url", desc.url},
+          {"interfaces", json::array()}}
 {
-    auto getInfo = [this] varlink_callback {
-        json::object_t info = {
-            {"vendor", desc.vendor},
-            {"product", desc.product},
-            {"version", desc.version},
-            {"url", desc.url}};
-        info["interfaces"] = json::array();
-        for (const auto& interface : interfaces) {
-            info["interfaces"].push_back(interface->name());
-        }
-        send_reply(info, false);
-    };
+    // Only called back for replies that aren't passed serialized, see message_call
+    auto getInfo = [this] varlink_callback { send_reply(json::object_t(info_reply), false); };
     auto getInterfaceDescription = [this] varlink_callback {
-        const auto& ifname = parameters["interface"].get<std::string>();
+        const auto& ifname = parameters["interface"].get_ref<const std::string&>();
 
-        if (const auto interface_it = find_interface(ifname); interface_it != interfaces.cend()) {
-            std::stringstream ss;
-            ss << **interface_it;
-            send_reply({{"description", ss.str()}}, false);
+        if (const auto interface = find_interface(ifname); interface != nullptr) {
+            send_reply(json::object_t(interface->description_reply()), false);
         }
         else {
             throw varlink_error("org.varlink.service.InterfaceNotFound", {{"interface", ifname}});
         }
     };
     add_interface(
-        org_varlink_service_varlink,
+        org_varlink_service_varlink_interface(),
         {{"GetInfo", getInfo}, {"GetInterfaceDescription", getInterfaceDescription}});
+    dispatch_table.at("org.varlink.service.GetInfo").cached =
+        [](const varlink_service& service, const json&) { return service.info_frame; };
+    dispatch_table.at("org.varlink.service.GetInterfaceDescription").cached =
+        [](const varlink_service& service, const json& parameters) {
+            const auto* interface =
+                service.find_interface(parameters["interface"].get_ref<const std::string&>());
+            return (interface != nullptr) ? interface->description_frame() : serialized_reply{};
+        };
+}
+
+#ifdef VARLINK_ENABLE_METRICS
+void varlink_service::add_metrics_interface()
+{
+    auto getMetrics = [this] varlink_callback {
+        const auto snapshot = metrics();
+        const auto& t = snapshot.transport;
+        json::array_t methods{};
+        for (const auto& [name, stats] : snapshot.methods) {
+            if (stats.calls == 0) continue;
+            methods.push_back(
+                {{"method", name},
+                 {"calls", stats.calls},
+                 {"errors", stats.errors},
+                 {"latency",
+                  {{"count", stats.latency.count()},
+                   {"p50", stats.latency.percentile(0.5)},
+                   {"p90", stats.latency.percentile(0.9)},
+                   {"p99", stats.latency.percentile(0.99)},
+                   {"p999", stats.latency.percentile(0.999)}}}});
+        }
+        json::array_t errors{};
+        for (const auto& [name, count] : snapshot.errors) {
+            errors.push_back({{"error", name}, {"count", count}});
+        }
+        json::object_t reply{};
+        reply.emplace(
+            "transport",
+            json{
+                {"sessions", t.sessions_active},
+                {"sessions_total", t.sessions_total},
+                {"bytes_received", t.bytes_received},
+                {"bytes_sent", t.bytes_sent},
+                {"calls_in_flight", t.calls_in_flight},
+                {"queued_replies", t.queued_replies}});
+        reply.emplace("methods", std::move(methods));
+        reply.emplace("errors", std::move(errors));
+        send_reply(std::move(reply), false);
+    };
+    add_interface(org_varlink_metrics_varlink_interface(), {{"GetMetrics", getMetrics}});
 }
+#endif
 }
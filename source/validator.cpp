@@ -0,0 +1,152 @@
+#include <varlink/detail/validator.hpp>
+#include <varlink/interface.hpp>
+
+namespace varlink::detail {
+namespace {
+const json& value_of(json::const_iterator it)
+{
+    return *it;
+}
+
+const json& value_of(json::object_t::const_iterator it)
+{
+    return it->second;
+}
+} // namespace
+
+type_validator::type_validator(
+    const varlink_interface& interface,
+    const type_spec& spec,
+    bool collection)
+{
+    std::map<compile_key, uint32_t> compiled;
+    compile(interface, spec, collection, compiled);
+}
+
+uint32_t type_validator::compile( // NOLINT(misc-no-recursion)
+    const varlink_interface& interface,
+    const type_spec& spec,
+    bool collection,
+    std::map<compile_key, uint32_t>& compiled)
+{
+    const compile_key key{&spec, collection};
+    if (const auto it = compiled.find(key); it != compiled.end()) { return it->second; }
+    // Reserve the slot first, so recursive types refer back to it
+    const auto index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    compiled.emplace(key, index);
+
+    node n{};
+    n.dict = spec.dict_type;
+    n.array = spec.array_type;
+    n.check_type = collection or not(spec.array_type or spec.dict_type);
+    if (n.dict or n.array) {
+        n.element = collection ? index : compile(interface, spec, true, compiled);
+    }
+
+    if (spec.is_enum()) {
+        n.kind = op::enumeration;
+        const auto& enm = spec.get<vl_enum>();
+        n.first = static_cast<uint32_t>(enum_values.size());
+        n.count = static_cast<uint32_t>(enm.size());
+        enum_values.insert(enum_values.end(), enm.begin(), enm.end());
+    }
+    else if (spec.is_string()) {
+        n.kind = op::type_name;
+        const auto& name = spec.get<string_type>();
+        n.prim = (name == "string") ? primitive::string
+               : (name == "int")    ? primitive::integer
+               : (name == "float")  ? primitive::number
+               : (name == "bool")   ? primitive::boolean
+               : (name == "object") ? primitive::object
+                                    : primitive::none;
+        if (interface.has_type(name)) {
+            n.target = compile(interface, interface.type(name).data, false, compiled);
+        }
+    }
+    else if (spec.is_struct()) {
+        n.kind = op::structure;
+        // Compile the members first, the fields of a struct have to be contiguous
+        std::vector<field> members;
+        for (const auto& [name, member_spec] : spec.get<vl_struct>()) {
+            members.push_back(
+                {std::string(name),
+                 member_spec.maybe_type,
+                 compile(interface, member_spec, false, compiled)});
+        }
+        n.first = static_cast<uint32_t>(fields.size());
+        n.count = static_cast<uint32_t>(members.size());
+        std::move(members.begin(), members.end(), std::back_inserter(fields));
+    }
+    nodes[index] = n;
+    return index;
+}
+
+void type_validator::validate(const json& data, std::string_view name) const
+{
+    validate(data, 0, name);
+}
+
+void type_validator::validate(const json::object_t& data, std::string_view name) const
+{
+    const auto& root = nodes.front();
+    if (root.kind == op::structure and not root.dict) { validate_fields(data, root); }
+    else {
+        validate(json(data), 0, name);
+    }
+}
+
+template <typename Object>
+void type_validator::validate_fields( // NOLINT(misc-no-recursion)
+    const Object& data,
+    const node& n) const
+{
+    for (uint32_t i = n.first; i < n.first + n.count; i++) {
+        const auto& f = fields[i];
+        const auto value = data.find(f.key);
+        if (value == data.end() or value_of(value).is_null()) {
+            if (not f.maybe) throw invalid_parameter(f.key);
+        }
+        else {
+            validate(value_of(value), f.node, f.key);
+        }
+    }
+}
+
+void type_validator::validate( // NOLINT(misc-no-recursion)
+    const json& data,
+    uint32_t index,
+    std::string_view name) const
+{
+    const auto& n = nodes[index];
+    if (n.kind == op::enumeration and data.is_string()) {
+        const auto& s = data.get_ref<const std::string&>();
+        const auto begin = enum_values.begin() + n.first;
+        if (std::find(begin, begin + n.count, s) == begin + n.count) {
+            throw invalid_parameter(data.dump());
+        }
+    }
+    else if ((n.dict and data.is_object()) or (n.array and data.is_array())) {
+        for (const auto& val : data) {
+            validate(val, n.element, name);
+        }
+    }
+    else if (n.kind == op::type_name and n.check_type) {
+        const bool matches = (n.prim == primitive::string and data.is_string())
+                          or (n.prim == primitive::integer and data.is_number_integer())
+                          or (n.prim == primitive::number and data.is_number())
+                          or (n.prim == primitive::boolean and data.is_boolean())
+                          or (n.prim == primitive::object and not data.is_null());
+        if (not matches) {
+            if (n.target == no_node) throw invalid_parameter(std::string(name));
+            validate(data, n.target, name);
+        }
+    }
+    else if (n.kind == op::structure and data.is_object()) {
+        validate_fields(data, n);
+    }
+    else {
+        throw invalid_parameter(data.dump());
+    }
+}
+} // namespace varlink::detail
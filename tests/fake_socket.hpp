@@ -48,12 +48,15 @@ class FakeSocket : public net::socket_base {
         return expect(net::buffer(str.data(), str.size() + 1));
     }
 
+#ifdef REQUIRE
+    // Only in the tests, the benchmarks use the fake socket without Catch2
     void validate_write() const
     {
         REQUIRE(
             std::string_view(sent_data.data(), sent_data.size())
             == std::string_view(sent_expect.data(), sent_expect.size()));
     }
+#endif
 
     // Actual methods called by code
 
@@ -65,16 +68,21 @@ class FakeSocket : public net::socket_base {
         }
     }
 
-    template <typename CompletionHandler>
-    auto async_write_some(const net::const_buffer& buffer, CompletionHandler&& handler)
+    template <typename ConstBufferSequence, typename CompletionHandler>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionHandler&& handler)
     {
         net::post(
             ctx_->get_executor(),
-            [this, buffer, handler = std::forward<CompletionHandler>(handler)]() mutable {
+            [this, buffers, handler = std::forward<CompletionHandler>(handler)]() mutable {
                 if (not cancelled) {
                     if (error_on_write) { return handler(net::error::broken_pipe, 0); }
                     else {
-                        auto n = send(buffer);
+                        size_t n = 0;
+                        for (auto it = net::buffer_sequence_begin(buffers);
+                             it != net::buffer_sequence_end(buffers) and n < write_max;
+                             ++it) {
+                            n += send(net::buffer(*it, write_max - n));
+                        }
                         return handler(std::error_code{}, n);
                     }
                 }
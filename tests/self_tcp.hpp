@@ -7,6 +7,8 @@ class TCPEnvironment : public BaseEnvironment {
     static constexpr const std::string_view varlink_uri{
 #ifdef VARLINK_TEST_ASYNC
         "tcp:127.0.0.1:61337"
+#elif VARLINK_TEST_SHARDED
+        "tcp:127.0.0.1:51338"
 #else
         "tcp:127.0.0.1:51337"
 #endif
@@ -17,6 +19,8 @@ class TCPEnvironment : public BaseEnvironment {
             net::ip::make_address_v4("127.0.0.1"),
 #ifdef VARLINK_TEST_ASYNC
             61337
+#elif VARLINK_TEST_SHARDED
+            51338
 #else
             51337
 #endif
@@ -34,6 +38,9 @@ class TCPEnvironment : public BaseEnvironment {
         timer = std::make_unique<net::steady_timer>(server->get_executor());
         server->async_serve_forever();
         worker = std::thread([&]() { ctx.run(); });
+#elif VARLINK_TEST_SHARDED
+        server = std::make_unique<test_server>(
+            varlink_uri, description, 4, threading_model::acceptor_per_thread);
 #else
         server = std::make_unique<test_server>(varlink_uri, description);
 #endif
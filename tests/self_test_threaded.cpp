@@ -1,6 +1,6 @@
 #include <thread>
 #include <catch2/catch_test_macros.hpp>
-#include <varlink/client.hpp>
+#include <varlink/client_pool.hpp>
 
 #ifdef VARLINK_TEST_TCP
 #include "self_tcp.hpp"
@@ -304,3 +304,149 @@ TEST_CASE("Testing server with raw socket data")
         REQUIRE(exp == data);
     }
 }
+
+#ifdef VARLINK_TEST_TCP
+TEST_CASE("TCP connections disable Nagle's algorithm")
+{
+    net::io_context ctx{};
+    json_connection<net::ip::tcp> connection(ctx);
+    net::ip::tcp::no_delay no_delay{false};
+
+    SECTION("Synchronous connect")
+    {
+        connection.connect(Environment::get_endpoint());
+        connection.socket().get_option(no_delay);
+        REQUIRE(no_delay.value());
+    }
+
+    SECTION("Asynchronous connect")
+    {
+        std::error_code ec{};
+        connection.async_connect(Environment::get_endpoint(), [&](std::error_code e) {
+            ec = e;
+            connection.socket().get_option(no_delay);
+        });
+        ctx.run();
+        REQUIRE(not ec);
+        REQUIRE(no_delay.value());
+    }
+}
+#endif
+
+TEST_CASE("Testing server with client pool")
+{
+    net::io_context ctx{};
+    auto pool = varlink_client_pool(ctx, 2);
+    const auto uri = Environment::varlink_uri;
+
+    SECTION("Synchronous calls from many threads")
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&pool, uri, t]() {
+                for (int i = 0; i < 10; i++) {
+                    const auto p = std::to_string(t * 100 + i);
+                    auto resp = pool.call(uri, "org.test.P", json{{"p", p}});
+                    REQUIRE(resp["q"].get<string>() == p);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        REQUIRE(pool.connection_count(uri) >= 1);
+        REQUIRE(pool.connection_count(uri) <= 2);
+        REQUIRE_VARLINK_ERROR(
+            pool.call(uri, "org.test.P", json{{"q", "invalid"}}),
+            "org.varlink.service.InvalidParameter",
+            "parameter",
+            "p");
+        REQUIRE(pool.call(uri, "org.test.P", json{{"p", "again"}})["q"].get<string>() == "again");
+    }
+
+    SECTION("Asynchronous calls")
+    {
+        std::vector<string> replies(20);
+        size_t errors{0};
+        for (size_t i = 0; i < replies.size(); i++) {
+            const auto p = std::to_string(i);
+            pool.async_call(uri, "org.test.P", json{{"p", p}}, [&, i](auto ec, const json& r) {
+                REQUIRE(not ec);
+                replies[i] = r["q"].get<string>();
+            });
+        }
+        pool.async_call(uri, "org.test.P", json{{"q", "invalid"}}, [&](auto ec, const json&) {
+            REQUIRE(ec.message() == "org.varlink.service.InvalidParameter");
+            errors++;
+        });
+        ctx.run();
+        for (size_t i = 0; i < replies.size(); i++) {
+            REQUIRE(replies[i] == std::to_string(i));
+        }
+        REQUIRE(errors == 1);
+        REQUIRE(pool.connection_count(uri) == 2);
+    }
+
+    SECTION("Broken connections are replaced")
+    {
+        auto single = varlink_client_pool(ctx, 1);
+        // Larger than the server accepts, so it closes the connection
+        const auto too_large =
+            std::string(varlink_client_unix::connection_type::default_max_message_size, 'x');
+        std::vector<std::error_code> failed{};
+        std::vector<string> replies{};
+        auto ping = [&](const string& p) {
+            single.async_call(uri, "org.test.P", json{{"p", p}}, [&, p](auto ec, const json& r) {
+                REQUIRE(not ec);
+                REQUIRE(r["q"].get<string>() == p);
+                replies.push_back(p);
+            });
+        };
+        single.async_call(uri, "org.test.P", json{{"p", too_large}}, [&](auto ec, const json&) {
+            failed.push_back(ec);
+            // Started while the broken connection still has calls and a send pending
+            if (failed.size() == 1) {
+                for (const auto* p : {"1", "2", "3"}) {
+                    ping(p);
+                }
+            }
+        });
+        // Queued behind the call that breaks the connection, they fail along with it
+        for (int i = 0; i < 3; i++) {
+            single.async_call(uri, "org.test.P", json{{"p", "queued"}}, [&](auto ec, const json&) {
+                failed.push_back(ec);
+            });
+        }
+        ctx.run();
+        REQUIRE(failed.size() == 4);
+        for (const auto& ec : failed) {
+            REQUIRE(ec);
+        }
+        REQUIRE(replies == std::vector<string>{"1", "2", "3"});
+        REQUIRE(single.connection_count(uri) == 1);
+        REQUIRE(single.call(uri, "org.test.P", json{{"p", "sync"}})["q"].get<string>() == "sync");
+    }
+
+    SECTION("Failed connects complete the waiting calls")
+    {
+        const auto* missing = "unix:/nonexistent/varlink.sock";
+        std::vector<std::error_code> errors{};
+        for (const auto* p : {"1", "2", "3"}) {
+            pool.async_call(missing, "org.test.P", json{{"p", p}}, [&](auto ec, const json&) {
+                errors.push_back(ec);
+            });
+        }
+        ctx.run();
+        REQUIRE(errors.size() == 3);
+        for (const auto& ec : errors) {
+            REQUIRE(ec);
+        }
+        REQUIRE(pool.connection_count(missing) <= 2);
+    }
+
+    SECTION("Bad uri")
+    {
+        REQUIRE_THROWS_AS(
+            pool.call("udp:127.0.0.1:1234", "org.test.P", json{}), std::invalid_argument);
+    }
+}
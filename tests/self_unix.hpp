@@ -8,6 +8,8 @@ class UnixEnvironment : public BaseEnvironment {
     static constexpr const std::string_view varlink_uri{
 #ifdef VARLINK_TEST_ASYNC
         "unix:test-integration-async.socket"
+#elif VARLINK_TEST_SHARDED
+        "unix:test-integration-sharded.socket"
 #else
         "unix:test-integration.socket"
 #endif
@@ -17,6 +19,8 @@ class UnixEnvironment : public BaseEnvironment {
         return {
 #ifdef VARLINK_TEST_ASYNC
             "test-integration-async.socket"
+#elif VARLINK_TEST_SHARDED
+            "test-integration-sharded.socket"
 #else
             "test-integration.socket"
 #endif
@@ -35,6 +39,9 @@ class UnixEnvironment : public BaseEnvironment {
         timer = std::make_unique<net::steady_timer>(server->get_executor());
         server->async_serve_forever();
         worker = std::thread([&]() { ctx.run(); });
+#elif VARLINK_TEST_SHARDED
+        server = std::make_unique<test_server>(
+            varlink_uri, description, 4, threading_model::io_context_per_thread);
 #else
         server = std::make_unique<test_server>(varlink_uri, description);
 #endif
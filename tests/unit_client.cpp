@@ -1,4 +1,5 @@
 #include <catch2/catch_test_macros.hpp>
+#include <thread>
 #include <varlink/async_client.hpp>
 
 #include "fake_socket.hpp"
@@ -242,4 +243,137 @@ TEST_CASE("Client async call processing")
         REQUIRE(ctx.run() > 0);
         REQUIRE(flag);
     }
+
+    SECTION("Pipelined calls")
+    {
+        std::string reply = R"({"parameters":{"pong":"1"}})";
+        reply += '\0';
+        reply += R"({"continues":true,"parameters":{"pong":"2"}})";
+        reply += '\0';
+        reply += R"({"parameters":{"pong":"2"}})";
+        reply += '\0';
+        reply += R"({"error":"org.test.Error","parameters":{"test":3}})";
+        setup_test(R"({"method":"org.test.Test","parameters":{"ping":"1"}})", reply);
+        client->socket().expect(R"({"method":"org.test.Test","oneway":true})");
+        client->socket().expect(
+            R"({"method":"org.test.Test","more":true,"parameters":{"ping":"2"}})");
+        client->socket().expect(R"({"method":"org.test.Test","parameters":{"ping":"3"}})");
+        client->set_pipelined(true);
+        REQUIRE(client->pipelined());
+
+        std::vector<std::string> replies{};
+        bool oneway_sent{false};
+        client->async_call("org.test.Test", {{"ping", "1"}}, [&](auto ec, const json& r) {
+            REQUIRE(not ec);
+            replies.push_back(r["pong"].get<std::string>());
+        });
+        client->async_call_oneway("org.test.Test", json::object(), [&](auto ec) {
+            REQUIRE(not ec);
+            oneway_sent = true;
+        });
+        client->async_call_more(
+            "org.test.Test", {{"ping", "2"}}, [&](auto ec, const json& r, bool more) {
+                REQUIRE(not ec);
+                replies.push_back(r["pong"].get<std::string>() + (more ? "+" : ""));
+            });
+        client->async_call("org.test.Test", {{"ping", "3"}}, [&](auto ec, const json& r) {
+            REQUIRE(ec.message() == "org.test.Error");
+            replies.push_back(std::to_string(r["test"].get<int>()));
+        });
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(oneway_sent);
+        REQUIRE(replies == std::vector<std::string>{"1", "2+", "2", "3"});
+        client->socket().validate_write();
+    }
+
+    SECTION("Pipelined calls fail together")
+    {
+        setup_test(
+            R"({"method":"org.test.Test","parameters":{"ping":"1"}})", R"({"parameters":{"pong":"1"}})");
+        client->socket().expect(R"({"method":"org.test.Test","parameters":{"ping":"2"}})");
+        client->socket().expect(R"({"method":"org.test.Test","parameters":{"ping":"3"}})");
+        client->set_pipelined(true);
+
+        std::vector<std::error_code> results{};
+        for (const auto* ping : {"1", "2", "3"}) {
+            client->async_call("org.test.Test", {{"ping", ping}}, [&](auto ec, const json&) {
+                results.push_back(ec);
+            });
+        }
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(results.size() == 3);
+        REQUIRE(not results[0]);
+        REQUIRE(results[1] == net::error::eof);
+        REQUIRE(results[2] == net::error::eof);
+        client->socket().validate_write();
+    }
+
+    SECTION("Pipelining can't be disabled with calls in flight")
+    {
+        setup_test(
+            R"({"method":"org.test.Test","parameters":{"ping":"1"}})", R"({"parameters":{"pong":"1"}})");
+        client->set_pipelined(true);
+
+        bool replied{false};
+        client->async_call("org.test.Test", {{"ping", "1"}}, [&](auto ec, const json& r) {
+            REQUIRE(not ec);
+            REQUIRE(r["pong"].get<std::string>() == "1");
+            replied = true;
+        });
+        REQUIRE_THROWS_AS(client->set_pipelined(false), std::logic_error);
+        REQUIRE(client->pipelined());
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(replied);
+        client->set_pipelined(false);
+        REQUIRE(not client->pipelined());
+    }
+}
+
+TEST_CASE("Varlink error category")
+{
+    auto& category = varlink_category();
+
+    SECTION("Service errors are registered up front")
+    {
+        auto ec = make_varlink_error("org.varlink.service.MethodNotFound");
+        REQUIRE(ec.category() == category);
+        REQUIRE(ec.message() == "org.varlink.service.MethodNotFound");
+        REQUIRE(ec == make_varlink_error("org.varlink.service.MethodNotFound"));
+        REQUIRE(ec != make_varlink_error("org.varlink.service.InterfaceNotFound"));
+        REQUIRE(
+            static_cast<size_t>(make_varlink_error("org.varlink.service.ExpectedMore").value())
+            < varlink_error_category::builtin_errors.size());
+    }
+
+    SECTION("Other errors keep their value")
+    {
+        auto ec = make_varlink_error("org.test.CategoryError");
+        REQUIRE(static_cast<size_t>(ec.value()) >= varlink_error_category::builtin_errors.size());
+        REQUIRE(ec.message() == "org.test.CategoryError");
+        REQUIRE(ec == make_varlink_error("org.test.CategoryError"));
+        REQUIRE(ec != make_varlink_error("org.varlink.service.CategoryError"));
+        REQUIRE(category.message(-1) == "unknown");
+        REQUIRE(category.message(1 << 20) == "unknown");
+    }
+
+    SECTION("Concurrent interning")
+    {
+        std::vector<std::thread> threads;
+        std::vector<std::vector<int>> values(4);
+        for (auto& v : values) {
+            threads.emplace_back([&v]() {
+                for (int i = 0; i < 100; i++) {
+                    const auto name = "org.test.Concurrent" + std::to_string(i);
+                    v.push_back(make_varlink_error(name).value());
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (const auto& v : values) {
+            REQUIRE(v == values.front());
+        }
+        REQUIRE(make_varlink_error("org.test.Concurrent42").message() == "org.test.Concurrent42");
+    }
 }
@@ -1,6 +1,8 @@
+#include <optional>
 #include <sstream>
 #include <catch2/catch_test_macros.hpp>
 
+#include <varlink/detail/validator.hpp>
 #include <varlink/interface.hpp>
 
 using namespace varlink;
@@ -437,3 +439,58 @@ TEST_CASE("Varlink interface types")
         }
     }
 }
+
+TEST_CASE("Varlink compiled type validator")
+{
+    varlink_interface interface(
+        "interface org.test\n"
+        "type Tree (name: string, children: []Tree, color: ?Color)\n"
+        "type Color (red, green)\n"
+        "method Plant(tree: Tree) -> (height: int)\n");
+    const auto& method = interface.method("Plant");
+    const type_validator parameters(interface, method.method_parameter_type());
+    const type_validator returns(interface, method.method_return_type());
+
+    SECTION("Validate recursive types")
+    {
+        REQUIRE_NOTHROW(parameters.validate(R"({"tree":{"name":"a","children":[]}})"_json));
+        REQUIRE_NOTHROW(parameters.validate(
+            R"({"tree":{"name":"a","children":[{"name":"b","children":[],"color":"red"}]}})"_json));
+        REQUIRE_THROWS_AS(
+            parameters.validate(R"({"tree":{"name":"a","children":[{"name":"b"}]}})"_json),
+            invalid_parameter);
+        REQUIRE_THROWS_AS(
+            parameters.validate(R"({"tree":{"name":"a","children":[
+                {"name":"b","children":[],"color":"blue"}]}})"_json),
+            invalid_parameter);
+    }
+
+    SECTION("Report the innermost field name")
+    {
+        try {
+            parameters.validate(R"({"tree":{"name":"a","children":[{"children":[]}]}})"_json);
+            FAIL("Expected invalid_parameter");
+        }
+        catch (invalid_parameter& e) {
+            REQUIRE(std::string(e.what()) == "name");
+        }
+    }
+
+    SECTION("Validate reply objects")
+    {
+        REQUIRE_NOTHROW(returns.validate(json::object_t{{"height", 3}}));
+        REQUIRE_THROWS_AS(returns.validate(json::object_t{{"height", "3"}}), invalid_parameter);
+        REQUIRE_THROWS_AS(returns.validate(json::object_t{}), invalid_parameter);
+    }
+
+    SECTION("Outlive the interface")
+    {
+        std::optional<type_validator> copy;
+        {
+            varlink_interface temporary("interface org.tmp\ntype E (a, b)\nmethod M(e: E) -> ()\n");
+            copy.emplace(temporary, temporary.method("M").method_parameter_type());
+        }
+        REQUIRE_NOTHROW(copy->validate(R"({"e":"a"})"_json));
+        REQUIRE_THROWS_AS(copy->validate(R"({"e":"c"})"_json), invalid_parameter);
+    }
+}
@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <varlink/detail/call_parser.hpp>
 #include <varlink/detail/message.hpp>
 
 using namespace varlink;
@@ -118,3 +119,62 @@ TEST_CASE("Varlink message serialization")
         REQUIRE(fromCallmode.json_data() == R"({"method":"org.test","more":true})"_json);
     }
 }
+
+TEST_CASE("Varlink call parser")
+{
+    const auto parse = [](std::string_view frame) {
+        return detail::parse_call(frame.data(), frame.data() + frame.size());
+    };
+
+    SECTION("Accepts the same calls as the message constructor")
+    {
+        const std::vector<std::string_view> frames{
+            R"({"method":""})",
+            R"({"method":"a.b.C","parameters":{}})",
+            R"({"method":"a.b.C","parameters":{"a":[1,{"b":null}],"c":{"d":"e"}},"more":true})",
+            R"({"parameters":{"x":1.5},"oneway":true,"method":"org.test.Test"})",
+            R"({"method":"org.test.Test","upgrade":true,"more":false})",
+            R"({"method":"org.test.Test","more":true,"oneway":true})",
+            R"({"method":"org.test.Test","other":{"nested":[1,[2]]},"x":null})",
+            R"({"method":42})",
+            R"({"method":null})",
+            R"({"method":[]})",
+            R"({"method":"","parameters":1})",
+            R"({"method":"","parameters":null})",
+            R"({"method":"","parameters":[]})",
+            R"({"method":"","more":1})",
+            R"({"method":"","oneway":null})",
+            R"(null)",
+            R"(42)",
+            R"("string")",
+            R"([{"method":""}])",
+            R"({})",
+            R"({"parameters":{}})",
+        };
+        for (const auto frame : frames) {
+            std::optional<basic_varlink_message> expected{};
+            try {
+                expected.emplace(json::parse(frame));
+            }
+            catch (std::exception&) {
+            }
+            const auto message = parse(frame);
+            INFO(frame);
+            REQUIRE(message.has_value() == expected.has_value());
+            if (expected) {
+                REQUIRE(message->mode() == expected->mode());
+                REQUIRE(message->interface() == expected->interface());
+                REQUIRE(message->method() == expected->method());
+                REQUIRE(message->parameters() == expected->parameters());
+            }
+        }
+    }
+
+    SECTION("Rejects invalid json")
+    {
+        REQUIRE(not parse(R"({"method":"a.b.C")"));
+        REQUIRE(not parse(R"({"method":"a.b.C"} {})"));
+        REQUIRE(not parse(R"({"method":"a.b.C","parameters":{"a":}})"));
+        REQUIRE(not parse(""));
+    }
+}
@@ -1,4 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <varlink/server_session.hpp>
 
 #include "fake_socket.hpp"
@@ -20,13 +23,18 @@ method TestTypes(ping: string) -> (pong: string)
 method NotImplemented() -> ()
 method VarlinkError() -> ()
 method Exception() -> ()
+method Deferred(ping: string) -> (pong: string)
 )INTERFACE";
 
+    size_t test_calls = 0;
+    size_t test_calls_before_deferred_reply = 0;
+
     service.add_interface(
         org_test_varlink,
         {
             {"Test",
-             [] varlink_callback {
+             [&test_calls] varlink_callback {
+                 ++test_calls;
                  if (mode == callmode::more) send_reply({{"pong", parameters["ping"]}}, true);
                  send_reply({{"pong", parameters["ping"]}}, false);
              }},
@@ -37,6 +45,16 @@ method Exception() -> ()
             {"VarlinkError",
              [] varlink_callback { throw varlink_error("org.test.Error", json::object()); }},
             {"Exception", [] varlink_callback { throw std::exception(); }},
+            {"Deferred",
+             [&] varlink_callback {
+                 // Reply two handler invocations later, so pipelined calls can overtake
+                 net::post(ctx, [&, parameters, send_reply]() {
+                     net::post(ctx, [&, parameters, send_reply]() {
+                         test_calls_before_deferred_reply = test_calls;
+                         send_reply({{"pong", parameters["ping"]}}, false);
+                     });
+                 });
+             }},
         });
 
     auto setup_test = [&](const auto& call, const auto& expected_response) {
@@ -166,6 +184,79 @@ method Exception() -> ()
         conn->socket().validate_write();
     }
 
+    SECTION("Sequential calls without pipelining")
+    {
+        std::string req = R"({"method":"org.test.Deferred","parameters":{"ping":"1"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"2"}})";
+        std::string resp = R"({"parameters":{"pong":"1"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"pong":"2"}})";
+        setup_test(req, resp);
+        conn->start();
+        REQUIRE(ctx.run() > 0);
+        conn->socket().validate_write();
+        REQUIRE(test_calls_before_deferred_reply == 0);
+    }
+
+    SECTION("Pipelined calls reply in request order")
+    {
+        std::string req = R"({"method":"org.test.Deferred","parameters":{"ping":"1"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"2"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"3"},"more":true})";
+        std::string resp = R"({"parameters":{"pong":"1"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"pong":"2"}})";
+        resp += '\0';
+        resp += R"({"continues":true,"parameters":{"pong":"3"}})";
+        resp += '\0';
+        resp += R"({"continues":false,"parameters":{"pong":"3"}})";
+        setup_test(req, resp);
+        conn->set_pipeline_depth(8);
+        conn->start();
+        REQUIRE(ctx.run() > 0);
+        conn->socket().validate_write();
+        REQUIRE(test_calls_before_deferred_reply == 2);
+    }
+
+    SECTION("Serialized org.varlink.service replies are held back in order")
+    {
+        std::string req = R"({"method":"org.test.Deferred","parameters":{"ping":"1"}})";
+        req += '\0';
+        req += R"({"method":"org.varlink.service.GetInfo","parameters":{}})";
+        std::string resp = R"({"parameters":{"pong":"1"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"interfaces":["org.varlink.service","org.test"],)"
+                R"("product":"unit","url":"http://example.org","vendor":"test","version":"1"}})";
+        setup_test(req, resp);
+        conn->set_pipeline_depth(8);
+        conn->start();
+        REQUIRE(ctx.run() > 0);
+        conn->socket().validate_write();
+    }
+
+    SECTION("Pipeline depth limits calls in flight")
+    {
+        std::string req = R"({"method":"org.test.Deferred","parameters":{"ping":"1"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"2"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"3"}})";
+        std::string resp = R"({"parameters":{"pong":"1"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"pong":"2"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"pong":"3"}})";
+        setup_test(req, resp);
+        conn->set_pipeline_depth(2);
+        conn->start();
+        REQUIRE(ctx.run() > 0);
+        conn->socket().validate_write();
+        REQUIRE(test_calls_before_deferred_reply == 1);
+    }
+
     SECTION("Write error")
     {
         setup_test(R"({"method":"org.test.NotImplemented"})", "");
@@ -174,4 +265,87 @@ method Exception() -> ()
         REQUIRE(ctx.run() > 0);
         REQUIRE(conn->socket().cancelled);
     }
+
+#ifdef VARLINK_ENABLE_METRICS
+    SECTION("Sessions count their connection into the service's metrics")
+    {
+        const std::string call = R"({"method":"org.test.Test","parameters":{"ping":"123"}})";
+        const std::string reply = R"({"parameters":{"pong":"123"}})";
+        setup_test(call, reply);
+        conn->start();
+        REQUIRE(service.metrics().transport.sessions_active == 1);
+        REQUIRE(ctx.run() > 0);
+        conn->socket().validate_write();
+        conn.reset();
+        const auto transport = service.metrics().transport;
+        REQUIRE(transport.sessions_active == 0);
+        REQUIRE(transport.sessions_total == 1);
+        REQUIRE(transport.bytes_received == call.size() + 1);
+        REQUIRE(transport.bytes_sent == reply.size() + 1);
+        REQUIRE(transport.calls_in_flight == 0);
+        REQUIRE(transport.queued_replies == 0);
+    }
+#endif
+#ifdef VARLINK_ENABLE_TRACING
+    SECTION("Sampled calls are traced through all stages")
+    {
+        std::string req = R"({"method":"org.test.Test","parameters":{"ping":"1"}})";
+        req += '\0';
+        req += R"({"method":"org.test.Test","parameters":{"ping":"2"}})";
+        std::string resp = R"({"parameters":{"pong":"1"}})";
+        resp += '\0';
+        resp += R"({"parameters":{"pong":"2"}})";
+        setup_test(req, resp);
+        start_tracing(2);
+        conn->start();
+        REQUIRE(ctx.run() > 0);
+        stop_tracing();
+        conn->socket().validate_write();
+
+        std::stringstream ss;
+        write_chrome_trace(ss);
+        const auto trace = json::parse(ss.str());
+        std::set<std::string> stages{};
+        std::set<uint64_t> calls{};
+        for (const auto& event : trace["traceEvents"]) {
+            REQUIRE(event["ph"] == "X");
+            REQUIRE(event["dur"].get<double>() >= 0.0);
+            stages.insert(event["name"].get<std::string>());
+            calls.insert(event["args"]["call"].get<uint64_t>());
+        }
+        REQUIRE(calls.size() == 1);
+        REQUIRE(
+            stages
+            == std::set<std::string>{
+                "receive", "message", "validate", "callback", "reply", "send", "write"});
+    }
+#endif
+}
+
+#ifdef VARLINK_ENABLE_TRACING
+TEST_CASE("Trace ring keeps the latest events")
+{
+    detail::trace_ring ring{};
+    const auto capacity = detail::trace_ring::capacity;
+    for (uint64_t call = 1; call <= capacity + 10; call++) {
+        ring.push({"stage", call, 0, 1});
+    }
+    std::vector<detail::trace_event> events{};
+    ring.read(events);
+    REQUIRE(events.size() == capacity);
+    REQUIRE(events.front().call == 11);
+    REQUIRE(events.back().call == capacity + 10);
+}
+
+TEST_CASE("Finished threads hand their trace ring on")
+{
+    auto& global = detail::tracer::instance();
+    std::thread([&global]() { global.local_ring().push({"stage", 1, 0, 1}); }).join();
+    const auto rings = global.rings().size();
+    for (uint64_t call = 2; call < 10; call++) {
+        std::thread([&global, call]() { global.local_ring().push({"stage", call, 0, 1}); })
+            .join();
+    }
+    REQUIRE(global.rings().size() == rings);
 }
+#endif
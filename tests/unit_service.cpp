@@ -1,10 +1,23 @@
 #include <catch2/catch_test_macros.hpp>
+#include <thread>
 
 #include <varlink/service.hpp>
 
 using namespace varlink;
 using std::string;
 
+namespace {
+// Takes serialized replies, like a server session
+struct reply_sender {
+    static constexpr bool accepts_serialized = true;
+    std::vector<json>& replies;
+    std::vector<std::string>& frames;
+
+    void operator()(json&& r) const { replies.push_back(std::move(r)); }
+    void operator()(serialized_reply&& r) const { frames.push_back(*r.frame); }
+};
+} // namespace
+
 TEST_CASE("Varlink service")
 {
     varlink_service service{{"test", "unit", "1", "http://example.org"}};
@@ -70,6 +83,51 @@ method Test(ping: string) -> (pong: string)
         REQUIRE(err["parameters"]["interface"].get<string>() == "org.not.test");
     }
 
+    SECTION("org.varlink.service replies are passed serialized")
+    {
+        std::vector<json> replies{};
+        std::vector<std::string> frames{};
+        const auto call = [&](std::string_view method, const json& parameters, callmode mode) {
+            service.message_call(
+                basic_varlink_message(method, parameters, mode), reply_sender{replies, frames});
+        };
+        call("org.varlink.service.GetInfo", json::object(), callmode::basic);
+        call(
+            "org.varlink.service.GetInterfaceDescription",
+            {{"interface", "org.test"}},
+            callmode::basic);
+        REQUIRE(replies.empty());
+        REQUIRE(frames.size() == 2);
+        REQUIRE(
+            json::parse(frames[0])["parameters"]["interfaces"]
+            == json{"org.varlink.service", "org.test"});
+        REQUIRE(
+            frames[1]
+            == R"({"parameters":{"description":"interface org.test\n\n)"
+               R"(method Test(ping: string) -> (pong: string)\n"}})");
+
+        // The callbacks reply to unknown interfaces and to calls with other modes
+        call(
+            "org.varlink.service.GetInterfaceDescription",
+            {{"interface", "org.not.test"}},
+            callmode::basic);
+        call("org.varlink.service.GetInfo", json::object(), callmode::more);
+        REQUIRE(frames.size() == 2);
+        REQUIRE(replies.size() == 2);
+        REQUIRE(replies[0]["error"] == "org.varlink.service.InterfaceNotFound");
+        REQUIRE(replies[1]["continues"] == false);
+        REQUIRE(replies[1]["parameters"] == json::parse(frames[0])["parameters"]);
+    }
+
+    SECTION("Generic reply handlers get json replies")
+    {
+        json info;
+        service.message_call(
+            basic_varlink_message("org.varlink.service.GetInfo", json::object(), callmode::basic),
+            [&](auto&& r) { info = r["parameters"]; });
+        REQUIRE(info["interfaces"] == json{"org.varlink.service", "org.test"});
+    }
+
     SECTION("Trying to add an interface a second time throws")
     {
         REQUIRE_THROWS_AS(
@@ -263,3 +321,218 @@ method EmptyReply() -> ()
         REQUIRE(err["parameters"]["parameter"].get<string>() == "pong");
     }
 }
+
+TEST_CASE("Varlink service moves replies")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    const char* sent{nullptr};
+    service.add_interface(
+        "interface org.test.move\nmethod Get() -> (data: string)\n",
+        {{"Get", [&sent] varlink_callback {
+              json::object_t reply{};
+              reply.emplace("data", std::string(4096, 'x'));
+              sent = reply["data"].get_ref<const std::string&>().data();
+              send_reply(std::move(reply), mode == callmode::more);
+              if (mode == callmode::more) send_reply({{"data", "last"}}, false);
+          }}});
+
+    for (const auto mode : {callmode::basic, callmode::more}) {
+        const bool more = (mode == callmode::more);
+        std::vector<json> replies;
+        service.message_call(
+            basic_varlink_message("org.test.move.Get", json::object(), mode),
+            [&replies](json&& r) { replies.push_back(std::move(r)); });
+        REQUIRE(replies.size() == (more ? 2 : 1));
+        REQUIRE(replies[0]["parameters"]["data"].get_ref<const std::string&>().data() == sent);
+    }
+}
+
+TEST_CASE("Varlink service moves parameters into consuming callbacks")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    std::string received{};
+    service.add_interface(
+        "interface org.test.move\nmethod Set(data: string) -> ()\n",
+        {{"Set",
+          consuming_callback(
+              [&received](auto&& parameters, callmode, const reply_function& send_reply) {
+                  json p = std::forward<decltype(parameters)>(parameters);
+                  received = std::move(p["data"].get_ref<std::string&>());
+                  send_reply({}, false);
+              })}});
+
+    const basic_varlink_message message("org.test.move.Set", {{"data", std::string(4096, 'x')}});
+    service.message_call(message, [](const json&) {});
+    REQUIRE(received == message.parameters()["data"].get<string>());
+    REQUIRE(received.data() != message.parameters()["data"].get_ref<const string&>().data());
+
+    auto consumed = message;
+    const auto* sent = consumed.parameters()["data"].get_ref<const string&>().data();
+    json reply;
+    service.message_call(std::move(consumed), [&reply](const json& r) { reply = r; });
+    REQUIRE(reply == json{{"parameters", json::object()}});
+    REQUIRE(received.data() == sent);
+}
+
+#ifdef VARLINK_ENABLE_METRICS
+TEST_CASE("Latency histogram")
+{
+    SECTION("Buckets cover every value and are at most 12.5% wide")
+    {
+        for (const uint64_t ns :
+             {0UL, 1UL, 7UL, 8UL, 9UL, 15UL, 16UL, 17UL, 100UL, 1000UL, 123456789UL, 1UL << 39}) {
+            const auto bucket = latency_histogram::bucket_index(ns);
+            REQUIRE(latency_histogram::bucket_upper_bound(bucket) >= ns);
+            if (bucket > 0) { REQUIRE(latency_histogram::bucket_upper_bound(bucket - 1) < ns); }
+            REQUIRE(latency_histogram::bucket_upper_bound(bucket) - ns <= ns / 8);
+        }
+        REQUIRE(latency_histogram::bucket_index(1UL << 50) == latency_histogram::bucket_count - 1);
+    }
+
+    SECTION("Percentiles and merge")
+    {
+        latency_histogram histogram{};
+        REQUIRE(histogram.percentile(0.5) == 0);
+        for (int64_t ns = 1; ns <= 1000; ns++) {
+            histogram.record(std::chrono::nanoseconds(ns));
+        }
+        REQUIRE(histogram.count() == 1000);
+        REQUIRE(histogram.percentile(0.5) >= 500);
+        REQUIRE(histogram.percentile(0.5) <= 500 + 500 / 8);
+        REQUIRE(histogram.percentile(0.99) >= 990);
+        REQUIRE(histogram.percentile(1.0) >= 1000);
+        histogram.merge(histogram);
+        REQUIRE(histogram.count() == 2000);
+        REQUIRE(histogram.percentile(0.5) >= 500);
+        REQUIRE(histogram.percentile(0.5) <= 500 + 500 / 8);
+    }
+}
+
+TEST_CASE("Varlink service metrics")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    service.add_interface(
+        "interface org.test.metrics\nmethod Ok() -> ()\nmethod Fail() -> ()\n"
+        "method Stream() -> (n: int)\n",
+        {{"Ok", [] varlink_callback { send_reply({}, false); }},
+         {"Fail",
+          [] varlink_callback { throw varlink_error("org.test.metrics.Failed", json::object()); }},
+         {"Stream", [] varlink_callback {
+              send_reply({{"n", 1}}, true);
+              send_reply({{"n", 2}}, false);
+          }}});
+    auto call = [&service](std::string_view method, callmode mode = callmode::basic) {
+        service.message_call(basic_varlink_message(method, json::object(), mode), [](json&&) {});
+    };
+
+    for (int i = 0; i < 3; i++) {
+        call("org.test.metrics.Ok");
+    }
+    call("org.test.metrics.Fail");
+    call("org.test.metrics.Fail");
+    call("org.test.metrics.Stream", callmode::more);
+    call("org.test.metrics.Unknown");
+
+    auto snapshot = service.metrics();
+    const auto& ok = snapshot.methods.at("org.test.metrics.Ok");
+    REQUIRE(ok.calls == 3);
+    REQUIRE(ok.errors == 0);
+    REQUIRE(ok.latency.count() == 3);
+    const auto& fail = snapshot.methods.at("org.test.metrics.Fail");
+    REQUIRE(fail.calls == 2);
+    REQUIRE(fail.errors == 2);
+    REQUIRE(fail.latency.count() == 2);
+    const auto& stream = snapshot.methods.at("org.test.metrics.Stream");
+    REQUIRE(stream.calls == 1);
+    REQUIRE(stream.latency.count() == 1);
+    REQUIRE(snapshot.methods.at("org.varlink.service.GetInfo").calls == 0);
+    REQUIRE(snapshot.methods.count("org.test.metrics.Unknown") == 0);
+    REQUIRE(snapshot.errors.at("org.test.metrics.Failed") == 2);
+    REQUIRE(snapshot.errors.at("org.varlink.service.MethodNotFound") == 1);
+
+    SECTION("Calls from several threads")
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 12; t++) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 1000; i++) {
+                    call("org.test.metrics.Ok");
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto after = service.metrics().methods.at("org.test.metrics.Ok");
+        REQUIRE(after.calls == 12003);
+        REQUIRE(after.latency.count() == 12003);
+    }
+
+    SECTION("Calls whose reply fails to send end with an error")
+    {
+        const auto broken_pipe = [](json&&) {
+            throw std::system_error(std::make_error_code(std::errc::broken_pipe));
+        };
+        service.message_call(
+            basic_varlink_message("org.test.metrics.Ok", json::object(), callmode::basic),
+            broken_pipe);
+        service.message_call(
+            basic_varlink_message("org.test.metrics.Stream", json::object(), callmode::more),
+            broken_pipe);
+        const auto after = service.metrics();
+        const auto& ok_after = after.methods.at("org.test.metrics.Ok");
+        REQUIRE(ok_after.calls == 4);
+        REQUIRE(ok_after.errors == 1);
+        REQUIRE(ok_after.latency.count() == 4);
+        const auto& stream_after = after.methods.at("org.test.metrics.Stream");
+        REQUIRE(stream_after.calls == 2);
+        REQUIRE(stream_after.errors == 1);
+        REQUIRE(stream_after.latency.count() == 2);
+        REQUIRE(after.transport.calls_in_flight == 0);
+    }
+
+    SECTION("Merge snapshots")
+    {
+        snapshot.merge(service.metrics());
+        REQUIRE(snapshot.methods.at("org.test.metrics.Ok").calls == 6);
+        REQUIRE(snapshot.methods.at("org.test.metrics.Ok").latency.count() == 6);
+        REQUIRE(snapshot.errors.at("org.test.metrics.Failed") == 4);
+    }
+}
+#endif
+
+#ifdef VARLINK_ENABLE_METRICS
+TEST_CASE("Varlink metrics interface")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    service.add_metrics_interface();
+    auto call = [&service](std::string_view method, const json& parameters) {
+        json reply;
+        service.message_call(basic_varlink_message(method, parameters), [&reply](json&& r) {
+            reply = std::move(r);
+        });
+        return reply;
+    };
+
+    call("org.varlink.service.GetInfo", json::object());
+    call("org.varlink.service.GetInterfaceDescription", {{"interface", "org.test.unknown"}});
+    const auto reply = call("org.varlink.metrics.GetMetrics", json::object());
+    REQUIRE(not reply.contains("error"));
+    const auto& metrics = reply["parameters"];
+    REQUIRE(metrics["transport"]["sessions"].get<int>() == 0);
+    // GetMetrics itself is still in flight while the snapshot is taken
+    REQUIRE(metrics["transport"]["calls_in_flight"].get<int>() == 1);
+    const auto& methods = metrics["methods"];
+    REQUIRE(methods.size() == 3);
+    REQUIRE(methods[0]["method"].get<string>() == "org.varlink.metrics.GetMetrics");
+    REQUIRE(methods[1]["method"].get<string>() == "org.varlink.service.GetInfo");
+    REQUIRE(methods[1]["calls"].get<int>() == 1);
+    REQUIRE(methods[1]["latency"]["count"].get<int>() == 1);
+    REQUIRE(methods[1]["latency"]["p50"].get<int64_t>() > 0);
+    REQUIRE(methods[2]["errors"].get<int>() == 1);
+    REQUIRE(metrics["errors"][0]["error"].get<string>() == "org.varlink.service.InterfaceNotFound");
+    REQUIRE(metrics["errors"][0]["count"].get<int>() == 1);
+    const auto info = call("org.varlink.service.GetInfo", json::object());
+    REQUIRE(info["parameters"]["interfaces"].size() == 2);
+}
+#endif
@@ -66,6 +66,46 @@ TEST_CASE("JSON transport sync read")
         REQUIRE(conn->receive()["object"].get<bool>() == true);
         REQUIRE_THROWS_AS((void)conn->receive(), std::system_error);
     }
+
+    SECTION("Read message larger than the initial buffer")
+    {
+        const auto big = json{{"data", std::string(4 * BUFSIZ, 'x')}};
+        auto socket = FakeSocket{ctx};
+        socket.write_max = 8 * BUFSIZ;
+        socket.setup_fake(big.dump());
+        socket.setup_fake(R"({"object":true})");
+        conn = std::make_unique<test_connection>(std::move(socket));
+        REQUIRE(conn->receive() == big);
+        REQUIRE(conn->receive()["object"].get<bool>() == true);
+    }
+
+    SECTION("Throw on message exceeding the maximum size")
+    {
+        auto socket = FakeSocket{ctx};
+        socket.write_max = 8 * BUFSIZ;
+        socket.setup_fake(json{{"data", std::string(2 * BUFSIZ, 'x')}}.dump());
+        conn = std::make_unique<test_connection>(std::move(socket));
+        conn->set_max_message_size(BUFSIZ);
+        REQUIRE_THROWS_AS((void)conn->receive(), std::system_error);
+    }
+
+    SECTION("Throw on message exceeding a maximum size below the buffer size")
+    {
+        setup_test(R"(["small"])", json{{"data", std::string(64, 'x')}}.dump());
+        conn->set_max_message_size(16);
+        REQUIRE(conn->receive() == json{"small"});
+        REQUIRE_THROWS_AS((void)conn->receive(), std::system_error);
+    }
+
+    SECTION("Throw on an incomplete message exceeding a small maximum size")
+    {
+        auto socket = FakeSocket{ctx};
+        const std::string incomplete(64, ' ');
+        socket.setup_fake(net::buffer(incomplete.data(), incomplete.size())); // No \0
+        conn = std::make_unique<test_connection>(std::move(socket));
+        conn->set_max_message_size(16);
+        REQUIRE_THROWS_AS((void)conn->receive(), std::system_error);
+    }
 }
 
 TEST_CASE("JSON transport async read")
@@ -176,6 +216,54 @@ TEST_CASE("JSON transport async read")
         REQUIRE(ctx.run() > 0);
         REQUIRE(flag == 2);
     }
+
+    SECTION("Read message larger than the initial buffer")
+    {
+        const auto big = json{{"data", std::string(4 * BUFSIZ, 'x')}};
+        auto socket = FakeSocket{ctx};
+        socket.write_max = 8 * BUFSIZ;
+        socket.setup_fake(big.dump());
+        conn = std::make_unique<test_connection>(std::move(socket));
+        bool flag{false};
+        conn->async_receive([&](auto ec, const json& r) {
+            REQUIRE(not ec);
+            REQUIRE(r == big);
+            flag = true;
+        });
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(flag);
+    }
+
+    SECTION("Error on message exceeding the maximum size")
+    {
+        auto socket = FakeSocket{ctx};
+        socket.write_max = 8 * BUFSIZ;
+        socket.setup_fake(json{{"data", std::string(2 * BUFSIZ, 'x')}}.dump());
+        conn = std::make_unique<test_connection>(std::move(socket));
+        conn->set_max_message_size(BUFSIZ);
+        bool flag{false};
+        conn->async_receive([&](auto ec, auto) {
+            REQUIRE(ec == net::error::message_size);
+            flag = true;
+        });
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(flag);
+    }
+
+    SECTION("Error on message exceeding a maximum size below the buffer size")
+    {
+        auto socket = FakeSocket{ctx};
+        socket.setup_fake(json{{"data", std::string(64, 'x')}}.dump());
+        conn = std::make_unique<test_connection>(std::move(socket));
+        conn->set_max_message_size(16);
+        bool flag{false};
+        conn->async_receive([&](auto ec, auto) {
+            REQUIRE(ec == net::error::message_size);
+            flag = true;
+        });
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(flag);
+    }
 }
 
 TEST_CASE("JSON transport sync write")
@@ -264,6 +352,27 @@ TEST_CASE("JSON transport async write")
         conn->socket().validate_write();
     }
 
+    SECTION("Coalesce queued writes")
+    {
+        setup_test(R"({"s":1})", R"({"s":2})", R"({"s":3})");
+        const auto first = R"({"s":1})"_json;
+        const auto second = R"({"s":2})"_json;
+        const auto third = R"({"s":3})"_json;
+        int count{0};
+        auto write_handler = [&](std::error_code ec) {
+            REQUIRE(not ec);
+            ++count;
+        };
+        conn->async_send(first, write_handler);
+        conn->async_send(second, write_handler);
+        conn->async_send(third, write_handler);
+        REQUIRE(ctx.run() > 0);
+        REQUIRE(count == 3);
+        conn->socket().validate_write();
+        REQUIRE(conn->write_stats().frames == 3);
+        REQUIRE(conn->write_stats().writes == 1);
+    }
+
     SECTION("Write to broken pipe")
     {
         setup_test();
@@ -0,0 +1,351 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+
+#include <varlink/service.hpp>
+
+#include "org.test.typed.varlink.hpp"
+#include "org.varlink.certification.varlink.hpp"
+
+using namespace varlink;
+using std::string;
+namespace typed = org::test::typed;
+namespace certification = org::varlink::certification;
+
+namespace {
+class typed_service : public typed::server {
+  public:
+    void Area(
+        typed::Area::parameters parameters,
+        callmode,
+        const typed_reply<typed::Area::reply>& send_reply) override
+    {
+        const auto& points = parameters.shape.points;
+        if (parameters.shape.kind != typed::Kind::closed or points.size() < 3) {
+            throw typed_error<typed::InvalidShape>({"open"});
+        }
+        int64_t twice_area{0};
+        for (size_t i = 0; i < points.size(); i++) {
+            const auto& next = points[(i + 1) % points.size()];
+            twice_area += points[i].x * next.y - next.x * points[i].y;
+        }
+        send_reply({static_cast<double>(std::abs(twice_area)) / 2.0});
+    }
+
+    void Echo(
+        typed::Echo::parameters parameters,
+        callmode,
+        const typed_reply<typed::Echo::reply>& send_reply) override
+    {
+        send_reply(
+            {std::move(parameters.value),
+             std::move(parameters.flags),
+             std::move(parameters.default_)});
+    }
+
+    void Count(
+        typed::Count::parameters parameters,
+        callmode mode,
+        const typed_reply<typed::Count::reply>& send_reply) override
+    {
+        for (int64_t n = 1; n < parameters.to and mode == callmode::more; n++) {
+            send_reply({n}, true);
+        }
+        send_reply({parameters.to});
+    }
+};
+
+// Its generated code lives in org::varlink::certification, where varlink:: would resolve to
+// org::varlink
+class certification_service : public certification::server {
+  public:
+    void Start(
+        certification::Start::parameters,
+        callmode,
+        const typed_reply<certification::Start::reply>& send_reply) override
+    {
+        send_reply({"client"});
+    }
+
+    void Test01(
+        certification::Test01::parameters parameters,
+        callmode,
+        const typed_reply<certification::Test01::reply>& send_reply) override
+    {
+        send_reply({parameters.client_id == "client"});
+    }
+};
+
+class fake_client {
+  public:
+    json reply{};
+    std::string method{};
+    json parameters{};
+
+    json call(std::string_view m, const json& p)
+    {
+        method = m;
+        parameters = p;
+        return reply;
+    }
+
+    template <typename ReplyHandler>
+    void async_call(std::string_view m, const json& p, ReplyHandler&& handler)
+    {
+        handler(std::error_code{}, call(m, p));
+    }
+};
+
+const json triangle = R"json({
+    "kind": "closed",
+    "points": [{"x": 0, "y": 0}, {"x": 4, "y": 0}, {"x": 0, "y": 3}],
+    "labels": {"a": "b"},
+    "style": {"color": "green", "width": 1.5}
+})json"_json;
+} // namespace
+
+TEST_CASE("Interface table generated at build time")
+{
+    const auto generated = org_test_typed_varlink_interface();
+    const auto parsed = varlink_interface(org_test_typed_varlink);
+    std::stringstream generated_ss, parsed_ss;
+    generated_ss << generated;
+    parsed_ss << parsed;
+    REQUIRE(generated.name() == "org.test.typed");
+    REQUIRE(generated.doc() == parsed.doc());
+    REQUIRE(generated_ss.str() == parsed_ss.str());
+    REQUIRE(generated.has_type("Shape"));
+    REQUIRE(generated.type("Tree").description == parsed.type("Tree").description);
+    REQUIRE(generated.type("Tree").description.find('\t') != std::string::npos);
+    REQUIRE(generated.has_method("Count"));
+    REQUIRE(generated.has_error("InvalidShape"));
+}
+
+TEST_CASE("Typed interface types")
+{
+    SECTION("Decode and encode a struct")
+    {
+        auto shape = decode_typed<typed::Shape>(triangle);
+        REQUIRE(shape.kind == typed::Kind::closed);
+        REQUIRE(shape.points.size() == 3);
+        REQUIRE(shape.points[1].x == 4);
+        REQUIRE(shape.labels.at("a") == "b");
+        REQUIRE(not shape.center.has_value());
+        REQUIRE(shape.style.color == typed::Shape::style_type::color_type::green);
+        REQUIRE(shape.style.width == 1.5);
+        REQUIRE(json(encode_typed(shape)) == triangle);
+
+        shape.center = typed::Point{1, 2};
+        REQUIRE(json(encode_typed(shape))["center"] == json{{"x", 1}, {"y", 2}});
+    }
+
+    SECTION("Decoding an rvalue moves its strings")
+    {
+        auto data = triangle;
+        data["labels"]["a"] = std::string(4096, 'b');
+        const auto* sent = data["labels"]["a"].get_ref<const std::string&>().data();
+        const auto copied = decode_typed<typed::Shape>(data);
+        REQUIRE(copied.labels.at("a").data() != sent);
+        const auto moved = decode_typed<typed::Shape>(std::move(data));
+        REQUIRE(moved.labels.at("a").data() == sent);
+        REQUIRE(moved.labels == copied.labels);
+    }
+
+    SECTION("Keywords get a trailing underscore")
+    {
+        auto echo = decode_typed<typed::Echo::parameters>(
+            {{"value", nullptr}, {"flags", {true, false}}, {"default", "d"}});
+        REQUIRE(not echo.value.has_value());
+        REQUIRE(echo.flags == std::vector<bool>{true, false});
+        REQUIRE(echo.default_ == "d");
+        REQUIRE(json(encode_typed(echo)) == json{{"flags", {true, false}}, {"default", "d"}});
+    }
+
+    SECTION("Recursive maybe fields are held by pointer")
+    {
+        const auto data = R"json({
+            "value": 1,
+            "left": {"value": 2},
+            "right": {"value": 3, "left": {"value": 4}}
+        })json"_json;
+        auto tree = decode_typed<typed::Tree>(data);
+        static_assert(std::is_same_v<decltype(tree.left), std::unique_ptr<typed::Tree>>);
+        REQUIRE(tree.value == 1);
+        REQUIRE(tree.left->value == 2);
+        REQUIRE(tree.left->left == nullptr);
+        REQUIRE(tree.right->left->value == 4);
+        REQUIRE(json(encode_typed(tree)) == data);
+
+        auto invalid = data;
+        invalid["right"]["left"]["value"] = "4";
+        REQUIRE_THROWS_AS(decode_typed<typed::Tree>(invalid), invalid_parameter);
+    }
+
+    SECTION("Decoding invalid data throws invalid_parameter")
+    {
+        auto invalid = triangle;
+        invalid.erase("kind");
+        REQUIRE_THROWS_AS(decode_typed<typed::Shape>(invalid), invalid_parameter);
+        invalid = triangle;
+        invalid["kind"] = "triangle";
+        REQUIRE_THROWS_AS(decode_typed<typed::Shape>(invalid), invalid_parameter);
+        invalid = triangle;
+        invalid["points"][0]["x"] = 0.5;
+        REQUIRE_THROWS_AS(decode_typed<typed::Shape>(invalid), invalid_parameter);
+        invalid = triangle;
+        invalid["labels"] = json::array();
+        REQUIRE_THROWS_AS(decode_typed<typed::Shape>(invalid), invalid_parameter);
+        REQUIRE_THROWS_AS(decode_typed<typed::Shape>(json::array()), invalid_parameter);
+    }
+}
+
+TEST_CASE("Typed interface server")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    typed_service impl{};
+    impl.add_to(service);
+    auto testcall = [&service](
+                        std::string_view method,
+                        const json& parameters,
+                        bool more,
+                        const std::function<void(const json&)>& callback) {
+        service.message_call(
+            basic_varlink_message(
+                {{"method", method}, {"parameters", parameters}, {"more", more}}),
+            callback);
+    };
+
+    SECTION("Call a method")
+    {
+        json reply;
+        testcall("org.test.typed.Area", {{"shape", triangle}}, false, [&](auto&& r) {
+            reply = r;
+        });
+        REQUIRE(reply["parameters"]["area"].get<double>() == 6.0);
+    }
+
+    SECTION("Call a method with more")
+    {
+        std::vector<json> replies;
+        testcall("org.test.typed.Count", {{"to", 3}}, true, [&](auto&& r) {
+            replies.push_back(r);
+        });
+        REQUIRE(replies.size() == 3);
+        REQUIRE(replies[0]["parameters"]["n"].get<int64_t>() == 1);
+        REQUIRE(replies[0]["continues"].get<bool>());
+        REQUIRE(replies[2]["parameters"]["n"].get<int64_t>() == 3);
+        REQUIRE(not replies[2]["continues"].get<bool>());
+    }
+
+    SECTION("Throw a typed error")
+    {
+        auto open = triangle;
+        open["kind"] = "open";
+        json err;
+        testcall("org.test.typed.Area", {{"shape", open}}, false, [&](auto&& r) { err = r; });
+        REQUIRE(err["error"].get<string>() == "org.test.typed.InvalidShape");
+        REQUIRE(err["parameters"]["reason"].get<string>() == "open");
+    }
+
+    SECTION("Call a method that isn't overridden")
+    {
+        json err;
+        testcall("org.test.typed.Unimplemented", json::object(), false, [&](auto&& r) {
+            err = r;
+        });
+        REQUIRE(err["error"].get<string>() == "org.varlink.service.MethodNotImplemented");
+    }
+
+    SECTION("Invalid parameters are reported like the generic validation does")
+    {
+        varlink_service generic{{"test", "unit", "1", "http://example.org"}};
+        generic.add_interface(
+            org_test_typed_varlink,
+            {{"Area", [] varlink_callback { send_reply({{"area", 0.0}}, false); }}});
+
+        auto missing_kind = triangle;
+        missing_kind.erase("kind");
+        auto float_coordinate = triangle;
+        float_coordinate["points"][0]["x"] = 0.5;
+        auto bad_color = triangle;
+        bad_color["style"]["color"] = "black";
+
+        for (const auto& shape : {missing_kind, float_coordinate, bad_color, json("shape")}) {
+            const auto message = basic_varlink_message(
+                {{"method", "org.test.typed.Area"}, {"parameters", {{"shape", shape}}}});
+            json expected, err;
+            generic.message_call(message, [&](const json& r) { expected = r; });
+            service.message_call(message, [&](const json& r) { err = r; });
+            REQUIRE(expected["error"].get<string>() == "org.varlink.service.InvalidParameter");
+            REQUIRE(err == expected);
+        }
+    }
+}
+
+TEST_CASE("Typed interface client")
+{
+    fake_client fake{};
+    typed::client<fake_client> client{fake};
+
+    SECTION("Synchronous call")
+    {
+        fake.reply = {{"area", 6.0}};
+        auto reply = client.Area({decode_typed<typed::Shape>(triangle)});
+        REQUIRE(fake.method == "org.test.typed.Area");
+        REQUIRE(fake.parameters == json{{"shape", triangle}});
+        REQUIRE(reply.area == 6.0);
+    }
+
+    SECTION("Synchronous call with an invalid reply")
+    {
+        fake.reply = {{"area", "six"}};
+        REQUIRE_THROWS_AS(client.Area({}), invalid_parameter);
+    }
+
+    SECTION("Asynchronous call")
+    {
+        fake.reply = {{"n", 3}};
+        std::error_code ec;
+        int64_t n{0};
+        client.async_Count({3}, [&](std::error_code e, typed::Count::reply reply) {
+            ec = e;
+            n = reply.n;
+        });
+        REQUIRE(not ec);
+        REQUIRE(n == 3);
+    }
+
+    SECTION("Asynchronous call with an invalid reply")
+    {
+        fake.reply = json::object();
+        std::error_code ec;
+        client.async_Count({3}, [&](std::error_code e, const typed::Count::reply&) { ec = e; });
+        REQUIRE(ec == std::errc::invalid_argument);
+    }
+}
+
+TEST_CASE("Typed interface in an org.varlink namespace")
+{
+    varlink_service service{{"test", "unit", "1", "http://example.org"}};
+    certification_service impl{};
+    impl.add_to(service);
+
+    json reply;
+    service.message_call(
+        basic_varlink_message("org.varlink.certification.Test01", json{{"client_id", "client"}}),
+        [&](const json& r) { reply = r; });
+    REQUIRE(reply["parameters"]["bool"].get<bool>());
+
+    const auto my_type = R"json({
+        "object": {"any": [1]},
+        "enum": "two",
+        "struct": {"first": 1, "second": "2"},
+        "array": ["a"],
+        "dictionary": {"k": "v"},
+        "stringset": {"s": {}},
+        "interface": {"foo": [{"x": "bar"}, {}], "anon": {"foo": true, "bar": false}}
+    })json"_json;
+    auto decoded = decode_typed<certification::MyType>(my_type);
+    REQUIRE(decoded.enum_ == certification::MyType::enum__type::two);
+    REQUIRE(decoded.interface.foo.value().size() == 2);
+    REQUIRE(json(encode_typed(decoded)) == my_type);
+}
@@ -0,0 +1,85 @@
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+
+#include <varlink/detail/unique_function.hpp>
+
+using varlink::detail::unique_function;
+
+namespace {
+// Counts live instances to check that moves and resets don't leak or double-destroy
+struct tracked {
+    static inline int alive{0};
+    tracked() { ++alive; }
+    tracked(const tracked&) = delete;
+    tracked(tracked&&) noexcept { ++alive; }
+    ~tracked() { --alive; }
+};
+} // namespace
+
+TEST_CASE("Unique function")
+{
+    SECTION("Empty function")
+    {
+        unique_function<void()> f{};
+        REQUIRE(not f);
+        REQUIRE_THROWS_AS(f(), std::bad_function_call);
+        f = [] {};
+        REQUIRE(f);
+        f = nullptr;
+        REQUIRE(not f);
+    }
+
+    SECTION("Move-only callable stored inline")
+    {
+        auto p = std::make_unique<int>(42);
+        auto fn = [p = std::move(p)](int a) { return *p + a; };
+        static_assert(unique_function<int(int)>::stored_inline<decltype(fn)>);
+        unique_function<int(int)> f{std::move(fn)};
+        REQUIRE(f(1) == 43);
+        auto g = std::move(f);
+        REQUIRE(not f);
+        REQUIRE(g(2) == 44);
+    }
+
+    SECTION("Large callable stored on the heap")
+    {
+        std::array<char, 256> large{};
+        large[255] = 'x';
+        auto fn = [large, t = tracked{}]() { return large[255]; };
+        static_assert(not unique_function<char()>::stored_inline<decltype(fn)>);
+        {
+            unique_function<char()> f{std::move(fn)};
+            auto g = std::move(f);
+            REQUIRE(g() == 'x');
+            REQUIRE(tracked::alive == 2);
+        }
+        REQUIRE(tracked::alive == 1);
+    }
+
+    SECTION("Lifetime of inline callables")
+    {
+        {
+            unique_function<void()> f{[t = tracked{}]() {}};
+            REQUIRE(tracked::alive == 1);
+            unique_function<void()> g{[t = tracked{}]() {}};
+            REQUIRE(tracked::alive == 2);
+            g = std::move(f);
+            REQUIRE(tracked::alive == 1);
+            f = std::move(g);
+            REQUIRE(tracked::alive == 1);
+        }
+        REQUIRE(tracked::alive == 0);
+    }
+
+    SECTION("Arguments are forwarded")
+    {
+        std::unique_ptr<int> result{};
+        unique_function<void(std::unique_ptr<int>, const int&)> f{
+            [&](std::unique_ptr<int> p, const int& i) {
+                *p += i;
+                result = std::move(p);
+            }};
+        f(std::make_unique<int>(1), 2);
+        REQUIRE(*result == 3);
+    }
+}